@@ -0,0 +1,203 @@
+//  commands.cpp
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "./constants.hpp"
+#include "../core/logger.hpp"
+#include "../core/transport.hpp"
+#include "../core/utils.hpp"
+
+//  Analyze command line ---------------------------------------------------------------------------------------------------------------
+bool process_args(int argc, char* argv[]) {
+
+	for (int i = 1; i < argc; ++i) {
+
+      	//  Help
+      	if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+          	  std::cout << help_text << std::endl;
+          	  return false;
+      	}
+
+      	//  Version
+      	if (std::strcmp(argv[i], "--version") == 0 || std::strcmp(argv[i], "-v") == 0) {
+          	  std::cout << "wsbench " << version << std::endl;
+          	  return false;
+      	}
+
+      	//  Router host address
+      	if (i > 0 && (std::strcmp(argv[i-1], "--host") == 0 || std::strcmp(argv[i-1], "-x") == 0) && argv[i] && *argv[i])
+          	  ws_host = argv[i];
+
+      	//	Router port
+      	if (i > 0 && (std::strcmp(argv[i-1], "--port") == 0 || std::strcmp(argv[i-1], "-p") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 65535);
+      	  if (!value) {
+      	    std::cout << "Invalid --port value" << std::endl;
+      	    return false;
+      	  }
+
+      	  port = argv[i];
+      	}
+
+      	//  Number of simulated clients
+      	if (i > 0 && (std::strcmp(argv[i-1], "--clients") == 0 || std::strcmp(argv[i-1], "-c") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 2, 50000);
+      	  if (!value) {
+      	    std::cout << "Invalid --clients value" << std::endl;
+      	    return false;
+      	  }
+
+      	  clients = value.value();
+      	}
+
+      	//  Traffic patterns
+      	if (i > 0 && (std::strcmp(argv[i-1], "--pattern") == 0 || std::strcmp(argv[i-1], "-m") == 0) && argv[i] && *argv[i]) {
+      	  patterns = split(argv[i], ",");
+      	  for (const auto& pattern : patterns) {
+      	    if (pattern != "unicast" && pattern != "broadcast" && pattern != "request") {
+      	      std::cout << "Invalid --pattern value: " << pattern << std::endl;
+      	      return false;
+      	    }
+      	  }
+      	}
+
+      	//  Payload sizes
+      	if (i > 0 && (std::strcmp(argv[i-1], "--sizes") == 0 || std::strcmp(argv[i-1], "-s") == 0) && argv[i] && *argv[i]) {
+      	  sizes.clear();
+      	  for (const auto& size : split(argv[i], ",")) {
+      	    auto value = string_to_int(size, 32, 16777216);
+      	    if (!value) {
+      	      std::cout << "Invalid --sizes value: " << size << std::endl;
+      	      return false;
+      	    }
+      	    sizes.push_back(value.value());
+      	  }
+      	}
+
+      	//  Send rate per client
+      	if (i > 0 && (std::strcmp(argv[i-1], "--rate") == 0 || std::strcmp(argv[i-1], "-r") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 1000000);
+      	  if (!value) {
+      	    std::cout << "Invalid --rate value" << std::endl;
+      	    return false;
+      	  }
+
+      	  rate = value.value();
+      	}
+
+      	//  Messages in flight per client
+      	if (i > 0 && (std::strcmp(argv[i-1], "--window") == 0 || std::strcmp(argv[i-1], "-n") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 4096);
+      	  if (!value) {
+      	    std::cout << "Invalid --window value" << std::endl;
+      	    return false;
+      	  }
+
+      	  window = value.value();
+      	}
+
+      	//  Warmup time
+      	if (i > 0 && (std::strcmp(argv[i-1], "--warmup") == 0 || std::strcmp(argv[i-1], "-u") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 3600);
+      	  if (!value) {
+      	    std::cout << "Invalid --warmup value" << std::endl;
+      	    return false;
+      	  }
+
+      	  warmup = value.value();
+      	}
+
+      	//  Measurement time
+      	if (i > 0 && (std::strcmp(argv[i-1], "--duration") == 0 || std::strcmp(argv[i-1], "-d") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 3600);
+      	  if (!value) {
+      	    std::cout << "Invalid --duration value" << std::endl;
+      	    return false;
+      	  }
+
+      	  duration = value.value();
+      	}
+
+      	//  Reconnection scenario
+      	if (i > 0 && (std::strcmp(argv[i-1], "--reconnect") == 0 || std::strcmp(argv[i-1], "-rc") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 3600000);
+      	  if (!value) {
+      	    std::cout << "Invalid --reconnect value" << std::endl;
+      	    return false;
+      	  }
+
+      	  reconnect_downtime = value.value();
+      	}
+
+      	//  Handshake cost of the stand-in router
+      	if (i > 0 && (std::strcmp(argv[i-1], "--handshake_cost") == 0 || std::strcmp(argv[i-1], "-hc") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 1000000);
+      	  if (!value) {
+      	    std::cout << "Invalid --handshake_cost value" << std::endl;
+      	    return false;
+      	  }
+
+      	  handshake_cost = value.value();
+      	}
+
+      	//  Reconnection interval of the clients
+      	if (i > 0 && (std::strcmp(argv[i-1], "--retry_interval") == 0 || std::strcmp(argv[i-1], "-ri") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 100, 60000);
+      	  if (!value) {
+      	    std::cout << "Invalid --retry_interval value" << std::endl;
+      	    return false;
+      	  }
+
+      	  retry_interval = value.value();
+      	}
+
+      	//  Longest reconnection backoff of the clients
+      	if (i > 0 && (std::strcmp(argv[i-1], "--retry_max") == 0 || std::strcmp(argv[i-1], "-rm") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 100, 3600000);
+      	  if (!value) {
+      	    std::cout << "Invalid --retry_max value" << std::endl;
+      	    return false;
+      	  }
+
+      	  retry_max = value.value();
+      	}
+
+      	//  Results file
+      	if (i > 0 && (std::strcmp(argv[i-1], "--output") == 0 || std::strcmp(argv[i-1], "-o") == 0) && argv[i] && *argv[i])
+          	  output_file = argv[i];
+
+      	//  Baseline results
+      	if (i > 0 && (std::strcmp(argv[i-1], "--baseline") == 0 || std::strcmp(argv[i-1], "-b") == 0) && argv[i] && *argv[i])
+          	  baseline_file = argv[i];
+
+      	//  Allowed regression
+      	if (i > 0 && (std::strcmp(argv[i-1], "--tolerance") == 0 || std::strcmp(argv[i-1], "-t") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 1000);
+      	  if (!value) {
+      	    std::cout << "Invalid --tolerance value" << std::endl;
+      	    return false;
+      	  }
+
+      	  tolerance = value.value();
+      	}
+
+      	//  Router to measure
+      	if (i > 0 && (std::strcmp(argv[i-1], "--router_pid") == 0 || std::strcmp(argv[i-1], "-rp") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, std::nullopt);
+      	  if (!value) {
+      	    std::cout << "Invalid --router_pid value" << std::endl;
+      	    return false;
+      	  }
+
+      	  router_pid = value.value();
+      	}
+
+      	//  Label of the results
+      	if (i > 0 && (std::strcmp(argv[i-1], "--label") == 0 || std::strcmp(argv[i-1], "-a") == 0) && argv[i] && *argv[i])
+          	  label = argv[i];
+	}
+
+	return process_log_args(argc, argv) && process_transport_args(argc, argv);
+}
@@ -0,0 +1,4 @@
+//  commands.hpp
+#pragma once
+
+bool process_args(int argc, char* argv[]);
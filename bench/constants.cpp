@@ -0,0 +1,74 @@
+#include "constants.hpp"
+#include <string>
+#include <vector>
+
+//  Version number and build time
+const std::string version = std::string("1.0.0 ") + __DATE__ + " " + __TIME__;
+
+//  Logging flags
+bool logging_enabled = true;
+bool logging_verbose = false;
+
+//  PID filename
+std::string pid_file = "/tmp/wsbench.pid";
+
+//  Router
+std::string ws_host = "127.0.0.1";
+std::string port = "8080";
+
+//  Simulated clients
+int clients = 8;
+
+//  Traffic
+std::vector<std::string> patterns = { "unicast" };
+std::vector<int> sizes = { 64, 1024, 16384 };
+int rate = 0;
+int window = 1;
+
+//  Timing, seconds
+int warmup = 2;
+int duration = 10;
+
+//  Reconnection scenario
+int reconnect_downtime = 0;
+int handshake_cost = 5000;
+int retry_interval = 1000;
+int retry_max = 30000;
+
+//  Results
+std::string output_file = "";
+std::string baseline_file = "";
+int tolerance = 10;
+std::string label = "";
+int router_pid = 0;
+
+//  Help text
+std::string help_text =
+    "wsbench - Load generator and latency benchmark for wsrouter\n"
+    "Version and build date: " + version + "\n\n"
+
+    "Command line arguments:\n\n"
+    "  --host, -x <host>                    Router host. Default: " + ws_host + "\n"
+    "  --port, -p <port>                    Router port. Default: " + port + "\n"
+    "  --clients, -c <clients>              Number of simulated clients, 2-50000. Default: " + std::to_string(clients) + "\n"
+    "  --pattern, -m <patterns>             Comma separated list of unicast, broadcast and request. Default: unicast\n"
+    "  --sizes, -s <bytes,...>              Comma separated list of payload sizes, 32-16777216. Default: 64,1024,16384\n"
+    "  --rate, -r <messages>                Messages per second sent by each client. 0 sends as fast as the router answers. Default: " + std::to_string(rate) + "\n"
+    "  --window, -n <messages>              Messages in flight per client when --rate is 0. Default: " + std::to_string(window) + "\n"
+    "  --warmup, -u <seconds>               Traffic before measuring each run. Default: " + std::to_string(warmup) + "\n"
+    "  --duration, -d <seconds>             Measurement time of each run. Default: " + std::to_string(duration) + "\n"
+    "  --reconnect, -rc <milliseconds>      Instead of the load runs, restart a stand-in router on --port, down this long, and time how fast the clients come back\n"
+    "  --handshake_cost, -hc <microseconds> CPU time of the stand-in router per handshake. Default: " + std::to_string(handshake_cost) + "\n"
+    "  --retry_interval, -ri <milliseconds> Reconnection interval of the clients, as in wsclient. Default: " + std::to_string(retry_interval) + "\n"
+    "  --retry_max, -rm <milliseconds>      Longest reconnection backoff of the clients, as in wsclient. Default: " + std::to_string(retry_max) + "\n"
+    "  --output, -o <path>                  Append the results to this file as JSON lines\n"
+    "  --baseline, -b <path>                Compare with results of an earlier run, exit with 2 on a regression\n"
+    "  --tolerance, -t <percent>            Allowed throughput drop or p99 latency increase against the baseline. Default: " + std::to_string(tolerance) + "\n"
+    "  --router_pid, -rp <pid>              Measure the memory of the router with this process ID per connected client\n"
+    "  --label, -a <text>                   Stored with the results, e.g. the router build being measured\n"
+    "  --nagle                              Leave Nagle's algorithm on for the clients' sockets\n"
+    "  --send_buffer, -sb <KB>              Socket send buffer of each client. Default: the system's\n"
+    "  --receive_buffer, -rb <KB>           Socket receive buffer of each client. Default: the system's\n"
+    "  --log_file, -lo <path>               Write the progress log to a file instead of the console\n"
+    "  --version, -v                        Version information\n"
+    "\n";
@@ -0,0 +1,54 @@
+// constants.hpp
+#pragma once
+#include <string>
+#include <vector>
+
+//  Version number and build time
+extern const std::string version;
+
+//  Logging flags
+extern bool logging_enabled;
+extern bool logging_verbose;
+
+//  PID filename
+extern std::string pid_file;
+
+//  Router host and port
+extern std::string ws_host;
+extern std::string port;
+
+//  Number of simulated clients
+extern int clients;
+
+//  Traffic patterns (unicast, broadcast, request) and payload sizes to run, each pattern with each size
+extern std::vector<std::string> patterns;
+extern std::vector<int> sizes;
+
+//  Messages per second per client; 0 runs a closed loop with "window" messages in flight per client
+extern int rate;
+extern int window;
+
+//  Seconds of warmup and of measurement for each run
+extern int warmup;
+extern int duration;
+
+//  Results file (JSON lines, appended), baseline to compare with, and allowed regression in percent
+extern std::string output_file;
+extern std::string baseline_file;
+extern int tolerance;
+
+//  Reconnection scenario: milliseconds the stand-in router stays down (0 runs the load benchmark instead), its CPU time
+//  per handshake in microseconds, and the clients' retry interval and longest backoff in milliseconds
+extern int reconnect_downtime;
+extern int handshake_cost;
+extern int retry_interval;
+extern int retry_max;
+
+//  Process ID of a router on this machine, to measure its memory per client (0: don't)
+extern int router_pid;
+
+//  Free text stored with the results, e.g. the router build being measured
+extern std::string label;
+
+//  Help text
+extern std::string help_text;
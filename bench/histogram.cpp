@@ -0,0 +1,52 @@
+//  histogram.cpp
+#include <algorithm>
+#include <cmath>
+
+#include "histogram.hpp"
+
+size_t Histogram::index(uint64_t ns) {
+    if (ns < (1u << sub_bits))
+        return ns;
+
+    //  Keep the top "sub_bits" bits; the shift selects the power of two
+    const int shift = 63 - __builtin_clzll(ns) - sub_bits + 1;
+    return (static_cast<size_t>(shift) << (sub_bits - 1)) + (ns >> shift);
+}
+
+//  Middle of a bucket
+uint64_t Histogram::value(size_t index) {
+    if (index < (1u << sub_bits))
+        return index;
+
+    const int shift = static_cast<int>(index >> (sub_bits - 1)) - 1;
+    const uint64_t mantissa = index - (static_cast<uint64_t>(shift) << (sub_bits - 1));
+    return (mantissa << shift) + ((uint64_t(1) << shift) >> 1);
+}
+
+void Histogram::record(uint64_t ns) {
+    ++buckets[index(ns)];
+    ++count_;
+    sum_ += ns;
+    min_ = std::min(min_, ns);
+    max_ = std::max(max_, ns);
+}
+
+void Histogram::reset() {
+    buckets.fill(0);
+    count_ = sum_ = max_ = 0;
+    min_ = UINT64_MAX;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (!count_)
+        return 0;
+
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen >= target)
+            return std::clamp(value(i), min_, max_);
+    }
+    return max_;
+}
@@ -0,0 +1,36 @@
+//  histogram.hpp
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+//  Latency histogram ---------------------------------------------------------------------------------------------------
+//  Log-linear buckets: exact below 128 ns, then 64 buckets per power of two, so any percentile is within 1.6% of the
+//  measured value while recording stays a couple of instructions and the histogram a fixed 30 KB, however long it runs.
+
+class Histogram {
+public:
+    void record(uint64_t ns);
+    void reset();
+
+    //  Nanoseconds, "p" between 0 and 100
+    uint64_t percentile(double p) const;
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+    uint64_t count() const { return count_; }
+
+private:
+    static constexpr int sub_bits = 7;
+    static constexpr size_t bucket_count = (64 - sub_bits + 2) << (sub_bits - 1);
+
+    static size_t index(uint64_t ns);
+    static uint64_t value(size_t index);
+
+    std::array<uint64_t, bucket_count> buckets{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
@@ -0,0 +1,442 @@
+//  load.cpp
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include "constants.hpp"
+#include "load.hpp"
+#include "report.hpp"
+#include "../core/transport.hpp"
+#include "../core/utils.hpp"
+
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+typedef std::chrono::steady_clock bench_clock;
+
+//  Simulated clients are called bench0, bench1... Unicast and request messages of a client go to the next one.
+static const std::string id_prefix = "bench";
+
+//  Handshakes in progress at once, so thousands of clients don't overflow the router's listen backlog
+static const size_t max_pending = 64;
+
+//  A client stops sending while this much is waiting in its socket buffer, instead of piling up memory.
+//  Such sends are counted as "throttled": the router (or the machine) is saturated at this rate.
+static const size_t max_buffered = 4 * 1024 * 1024;
+
+//  Time for the messages still in flight to arrive between runs
+static const auto drain_time = std::chrono::seconds(1);
+
+struct Peer {
+    std::string id;
+    client::connection_ptr con;
+    size_t target = 0;
+    uint64_t issued = 0;        //  Messages sent in the current run, open loop mode
+};
+
+static client wsb;
+static std::vector<Peer> peers;
+static std::unique_ptr<asio::steady_timer> phase_timer;
+static std::unique_ptr<asio::steady_timer> tick_timer;
+static std::string ws_fullhost;
+
+static size_t next_connection = 0;
+static size_t opened = 0;
+static size_t closed = 0;
+static bool confirmed = false;
+static bool finished = false;
+static bool failed = false;
+
+//  Current run. Messages carry the tag they were sent with: even while warming up, odd while measuring.
+static std::vector<RunResult>* runs = nullptr;
+static size_t run_index = 0;
+static RunResult* current = nullptr;
+static int tag = 0;
+static bool sending = false;
+static bool measuring = false;
+static bench_clock::time_point run_start;
+
+//  Router memory: before the clients connect, and per client once they are confirmed
+static long idle_rss = 0;
+static double rss_per_client = 0;
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+static void after(bench_clock::duration delay, std::function<void()> fn) {
+    phase_timer->expires_after(delay);
+    phase_timer->async_wait([fn](const std::error_code& ec) {
+        if (!ec)
+            fn();
+    });
+}
+
+//  Resident memory of the router in KB, or 0
+static long router_rss() {
+    if (!router_pid)
+        return 0;
+
+    std::ifstream in("/proc/" + std::to_string(router_pid) + "/status");
+    for (std::string line; std::getline(in, line);) {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+static void abort_bench(const std::string& error) {
+    if (finished)
+        return;
+    log("ERROR", error);
+    failed = finished = true;
+    wsb.stop();
+}
+
+//  Sending -------------------------------------------------------------------------------------------------------------
+
+//  <recipient>::<sender>::<expects reply>::<reply to>::<tag>:<send time, ns>:<padding up to the payload size>
+static void send_from(size_t i) {
+    Peer& peer = peers[i];
+    if (peer.con->get_buffered_amount() > max_buffered) {
+        if (measuring)
+            ++current->throttled;
+        return;
+    }
+
+    const bool request = current->pattern == "request";
+    const std::string& recipient = current->pattern == "broadcast" ? "*" : peers[peer.target].id;
+
+    std::string msg;
+    msg.reserve(recipient.size() + 2 * peer.id.size() + current->size + 16);
+    msg += recipient;
+    msg += "::";
+    msg += peer.id;
+    if (request) {
+        msg += "::1::";
+        msg += peer.id;
+    } else
+        msg += "::0::";
+    msg += "::";
+
+    const size_t content = msg.size();
+    msg += std::to_string(tag);
+    msg += ':';
+    msg += std::to_string(now_ns());
+    msg += ':';
+    if (msg.size() - content < static_cast<size_t>(current->size))
+        msg.append(current->size - (msg.size() - content), 'x');
+
+    auto ec = peer.con->send(msg, websocketpp::frame::opcode::text);
+    if (ec) {
+        ++current->errors;
+        return;
+    }
+    if (measuring)
+        ++current->sent;
+}
+
+//  Open loop: every millisecond, each client catches up with "rate". Clients are spread evenly within an interval.
+static void tick() {
+    if (!sending)
+        return;
+
+    const double elapsed = std::chrono::duration<double>(bench_clock::now() - run_start).count();
+    for (size_t i = 0; i < peers.size(); ++i) {
+        const uint64_t due = static_cast<uint64_t>(elapsed * rate + static_cast<double>(i) / peers.size());
+        while (peers[i].issued < due) {
+            send_from(i);
+            ++peers[i].issued;
+        }
+    }
+
+    tick_timer->expires_at(tick_timer->expiry() + std::chrono::milliseconds(1));
+    tick_timer->async_wait([](const std::error_code& ec) {
+        if (!ec)
+            tick();
+    });
+}
+
+//  Closed loop: a delivered message lets its sender send the next one
+static void complete(size_t sender) {
+    if (sending && rate == 0)
+        send_from(sender);
+}
+
+//  Runs ----------------------------------------------------------------------------------------------------------------
+
+static void finish() {
+    finished = true;
+    for (auto& peer : peers) {
+        websocketpp::lib::error_code ec;
+        peer.con->close(websocketpp::close::status::normal, "Benchmark finished", ec);
+    }
+
+    //  In case the router doesn't answer the close handshake
+    after(std::chrono::seconds(2), []() { wsb.stop(); });
+}
+
+static void start_run() {
+    if (run_index == runs->size()) {
+        finish();
+        return;
+    }
+
+    current = &(*runs)[run_index];
+    current->router_kb = rss_per_client;
+    tag = static_cast<int>(run_index) * 2;
+    sending = true;
+    measuring = false;
+    run_start = bench_clock::now();
+
+    log("LOG", "Running " + current->pattern + " with " + std::to_string(current->size) + " byte payloads...");
+
+    if (rate == 0) {
+        for (size_t i = 0; i < peers.size(); ++i)
+            for (int w = 0; w < window; ++w)
+                send_from(i);
+    } else {
+        for (auto& peer : peers)
+            peer.issued = 0;
+        tick_timer->expires_after(std::chrono::milliseconds(1));
+        tick_timer->async_wait([](const std::error_code& ec) {
+            if (!ec)
+                tick();
+        });
+    }
+
+    //  Warmup, measurement, drain
+    after(std::chrono::seconds(warmup), []() {
+        ++tag;
+        measuring = true;
+        auto measure_start = bench_clock::now();
+
+        after(std::chrono::seconds(duration), [measure_start]() {
+            measuring = false;
+            sending = false;
+            tick_timer->cancel();
+            current->seconds = std::chrono::duration<double>(bench_clock::now() - measure_start).count();
+
+            after(drain_time, []() {
+                print_result(*current);
+                ++run_index;
+                start_run();
+            });
+        });
+    });
+}
+
+//  Waits until the router confirmed every client. Clients hello on open; bench0 polls the client count.
+static void wait_confirmed(int attempts) {
+    if (confirmed)
+        return;
+    if (attempts == 0) {
+        abort_bench("The router didn't confirm " + std::to_string(peers.size()) + " clients. Is its --connections limit high enough?");
+        return;
+    }
+
+    peers[0].con->send("router::" + peers[0].id + "::clients::", websocketpp::frame::opcode::text);
+    after(std::chrono::milliseconds(100), [attempts]() { wait_confirmed(attempts - 1); });
+}
+
+//  Incoming messages ---------------------------------------------------------------------------------------------------
+
+static void on_router_message(size_t i, std::string_view payload) {
+    //  router::<code>::::<message>
+    const std::string_view code = payload.substr(8, payload.find("::", 8) - 8);
+    const size_t text = payload.find("::::");
+    const std::string_view message = text == std::string_view::npos ? std::string_view() : payload.substr(text + 4);
+
+    if (code != "0") {
+        log("ERROR", peers[i].id + " got a router error: " + std::string(message));
+        if (current)
+            ++current->errors;
+        return;
+    }
+
+    //  Answer to "clients": <confirmed>,<unconfirmed>
+    if (!confirmed && i == 0) {
+        int count = 0;
+        auto [end, ec] = std::from_chars(message.data(), message.data() + message.size(), count);
+        if (ec == std::errc() && end != message.data() + message.size() && *end == ',' && count >= static_cast<int>(peers.size())) {
+            confirmed = true;
+            log("LOG", std::to_string(peers.size()) + " clients confirmed by the router");
+
+            const long rss = router_rss();
+            if (idle_rss && rss) {
+                rss_per_client = static_cast<double>(rss - idle_rss) / peers.size();
+                log("LOG", "Router memory: " + std::to_string(idle_rss / 1024) + " MB idle, " + std::to_string(rss / 1024) +
+                    " MB with " + std::to_string(peers.size()) + " clients, " + std::to_string(static_cast<long>(rss_per_client + 0.5)) + " KB per client");
+            }
+            start_run();
+        }
+    }
+}
+
+static void on_message(size_t i, const std::string& payload) {
+    if (payload.compare(0, 8, "router::") == 0) {
+        on_router_message(i, payload);
+        return;
+    }
+
+    //  Other clients of the router may talk before the first run
+    if (!current)
+        return;
+
+    //  <sender>::<expects reply>::<reply to>::<tag>:<send time>:<padding>
+    const size_t a = payload.find("::");
+    const size_t b = a == std::string::npos ? a : payload.find("::", a + 2);
+    const size_t c = b == std::string::npos ? b : payload.find("::", b + 2);
+    if (c == std::string::npos)
+        return;
+
+    //  Request: answer with the same content
+    if (payload.compare(a + 2, b - a - 2, "1") == 0) {
+        std::string reply;
+        reply.reserve(payload.size() + peers[i].id.size());
+        reply.append(payload, b + 2, c - b - 2);
+        reply += "::";
+        reply += peers[i].id;
+        reply += "::0::";
+        reply.append(payload, c, std::string::npos);
+        peers[i].con->send(reply, websocketpp::frame::opcode::text);
+        return;
+    }
+
+    int sent_tag = 0;
+    uint64_t sent_ns = 0;
+    const char* p = payload.data() + c + 2;
+    const char* last = payload.data() + payload.size();
+    auto parsed = std::from_chars(p, last, sent_tag);
+    if (parsed.ec != std::errc() || parsed.ptr == last || *parsed.ptr != ':')
+        return;
+    parsed = std::from_chars(parsed.ptr + 1, last, sent_ns);
+    if (parsed.ec != std::errc())
+        return;
+
+    if (measuring && sent_tag == tag) {
+        current->latency.record(now_ns() - sent_ns);
+        ++current->received;
+    }
+
+    //  Who sent it
+    size_t sender = 0;
+    if (a <= id_prefix.size() || payload.compare(0, id_prefix.size(), id_prefix) != 0)
+        return;
+    parsed = std::from_chars(payload.data() + id_prefix.size(), payload.data() + a, sender);
+    if (parsed.ec != std::errc() || parsed.ptr != payload.data() + a || sender >= peers.size())
+        return;
+
+    if (current->pattern == "request")
+        complete(i);
+    else if (peers[sender].target == i)
+        complete(sender);
+}
+
+//  Connections ---------------------------------------------------------------------------------------------------------
+
+static void connect_next() {
+    if (next_connection == peers.size() || finished)
+        return;
+
+    const size_t i = next_connection++;
+    websocketpp::lib::error_code ec;
+    auto con = wsb.get_connection(ws_fullhost, ec);
+    if (ec) {
+        abort_bench("Connection error: " + ec.message());
+        return;
+    }
+
+    con->set_open_handler([i](websocketpp::connection_hdl) {
+        peers[i].con->send("router::" + peers[i].id + "::hello::" + peers[i].id + "::", websocketpp::frame::opcode::text);
+        if (++opened == peers.size()) {
+            log("LOG", "Connected " + std::to_string(opened) + " clients to " + ws_fullhost);
+            wait_confirmed(100);
+        }
+        connect_next();
+    });
+
+    con->set_fail_handler([i](websocketpp::connection_hdl) {
+        abort_bench("Connection of " + peers[i].id + " failed: " + peers[i].con->get_ec().message());
+    });
+
+    con->set_close_handler([i](websocketpp::connection_hdl) {
+        if (!finished)
+            abort_bench("The router closed the connection of " + peers[i].id + ": " + peers[i].con->get_remote_close_reason());
+        else if (++closed == opened)
+            phase_timer->cancel();
+    });
+
+    con->set_message_handler([i](websocketpp::connection_hdl, client::message_ptr msg) {
+        on_message(i, msg->get_payload());
+    });
+
+    peers[i].con = con;
+    wsb.connect(con);
+}
+
+//  Runs the benchmark --------------------------------------------------------------------------------------------------
+
+bool run_bench(std::vector<RunResult>& results) {
+    for (const auto& pattern : patterns) {
+        for (int size : sizes) {
+            results.emplace_back();
+            results.back().pattern = pattern;
+            results.back().size = size;
+        }
+    }
+    runs = &results;
+
+    peers.resize(clients);
+    for (size_t i = 0; i < peers.size(); ++i) {
+        peers[i].id = id_prefix + std::to_string(i);
+        peers[i].target = (i + 1) % peers.size();
+    }
+
+    ws_fullhost = "ws://" + ws_host + ":" + port;
+    idle_rss = router_rss();
+    if (router_pid && !idle_rss)
+        log("ERROR", "Cannot read the memory of process " + std::to_string(router_pid));
+    log("LOG", "Connecting " + std::to_string(clients) + " clients to " + ws_fullhost + "...");
+
+    wsb.clear_access_channels(websocketpp::log::alevel::all);
+    wsb.clear_error_channels(websocketpp::log::elevel::all);
+
+    try {
+        wsb.init_asio();
+        wsb.set_tcp_post_init_handler([](websocketpp::connection_hdl hdl) {
+            websocketpp::lib::error_code ec;
+            auto con = wsb.get_con_from_hdl(hdl, ec);
+            if (!ec)
+                tune_socket(con->get_raw_socket());
+        });
+        phase_timer = std::make_unique<asio::steady_timer>(wsb.get_io_service());
+        tick_timer = std::make_unique<asio::steady_timer>(wsb.get_io_service());
+
+        for (size_t i = 0; i < std::min(max_pending, peers.size()); ++i)
+            connect_next();
+
+        wsb.run();
+    }
+    catch (const std::exception& e) {
+        log("ERROR", "Benchmark failed: " + std::string(e.what()));
+        return false;
+    }
+
+    //  Results of an interrupted benchmark are incomplete
+    return !failed && run_index == results.size();
+}
+
+void stop_bench() {
+    abort_bench("Benchmark interrupted");
+}
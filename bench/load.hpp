@@ -0,0 +1,27 @@
+//  load.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "histogram.hpp"
+
+//  One pattern with one payload size
+struct RunResult {
+    std::string pattern;
+    int size = 0;
+    double seconds = 0;
+    uint64_t sent = 0;          //  Messages sent while measuring
+    uint64_t received = 0;      //  Deliveries (unicast, broadcast) or replies (request) while measuring
+    uint64_t errors = 0;        //  Send failures and router errors
+    uint64_t throttled = 0;     //  Sends skipped because the router didn't keep up (see load.cpp)
+    Histogram latency;          //  One-way for unicast and broadcast, round trip for request
+    double router_kb = 0;       //  Router memory per connected client before any traffic (--router_pid), KB
+};
+
+//  Connects the simulated clients and runs every pattern with every size. Returns false if the run couldn't finish.
+bool run_bench(std::vector<RunResult>& results);
+
+//  Stops a running benchmark (signal handler)
+void stop_bench();
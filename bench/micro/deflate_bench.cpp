@@ -0,0 +1,84 @@
+//  deflate_bench.cpp
+//  permessage-deflate: CPU time versus bytes saved, per window size and context takeover
+//
+//  g++ -std=c++17 -O2 -o deflate_bench bench/micro/deflate_bench.cpp -lz
+//  bash build.sh <platform> deflate_bench     (static, for the target device: bin/deflate_bench_<platform>)
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+//  A stream of JSON telemetry messages of roughly "size" bytes each, with slowly changing values
+static std::vector<std::string> telemetry(size_t size, size_t count) {
+    std::vector<std::string> messages;
+    unsigned seed = 12345;
+
+    for (size_t m = 0; m < count; ++m) {
+        std::string msg = "dashcam::0::::{\"device\":\"dashcam\",\"seq\":" + std::to_string(m) + ",\"samples\":[";
+        while (msg.size() < size) {
+            seed = seed * 1103515245 + 12345;
+            msg += "{\"t\":" + std::to_string(1700000000 + m) + ",\"temp\":" + std::to_string(20 + (seed >> 16) % 10) +
+                "." + std::to_string((seed >> 8) % 100) + ",\"rpm\":" + std::to_string(800 + (seed >> 12) % 4000) +
+                ",\"gps\":[47.49" + std::to_string((seed >> 4) % 1000) + ",19.04" + std::to_string((seed >> 6) % 1000) + "]},";
+        }
+        msg += "{}]}";
+        messages.push_back(msg);
+    }
+    return messages;
+}
+
+//  Compresses every message the way permessage-deflate does (raw deflate, sync flush, trailer removed).
+//  Returns compressed bytes and microseconds per message.
+static void run(const std::vector<std::string>& messages, int window_bits, bool takeover, size_t& bytes, double& us) {
+    z_stream zs{};
+    deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -window_bits, 8, Z_DEFAULT_STRATEGY);
+
+    std::vector<unsigned char> out(messages[0].size() * 2 + 1024);
+    bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& msg : messages) {
+        if (!takeover)
+            deflateReset(&zs);
+
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(msg.data()));
+        zs.avail_in = msg.size();
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+        deflate(&zs, Z_SYNC_FLUSH);
+
+        bytes += out.size() - zs.avail_out - 4;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    us = std::chrono::duration<double, std::micro>(elapsed).count() / messages.size();
+
+    deflateEnd(&zs);
+}
+
+int main() {
+    std::printf("%-8s %-6s %-9s %10s %8s %10s\n", "size", "window", "takeover", "us/msg", "ratio", "saved/ms");
+
+    for (size_t size : { 256, 1024, 4096, 65536 }) {
+        auto messages = telemetry(size, size >= 65536 ? 200 : 2000);
+        size_t raw = 0;
+        for (const auto& msg : messages)
+            raw += msg.size();
+
+        for (int window_bits : { 9, 12, 15 }) {
+            for (bool takeover : { true, false }) {
+                size_t bytes;
+                double us;
+                run(messages, window_bits, takeover, bytes, us);
+
+                //  Bytes saved per millisecond of CPU: the exchange rate between link and processor
+                double saved_per_ms = (raw - bytes) / (us * messages.size() / 1000.0);
+                std::printf("%-8zu %-6d %-9s %10.1f %7.1fx %10.0f\n", size, window_bits, takeover ? "yes" : "no",
+                    us, static_cast<double>(raw) / bytes, saved_per_ms);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+//  parser_bench.cpp
+//  Message header parsing: split()/join() versus parse_header()
+//
+//  g++ -std=c++17 -O2 -DROUTER -o parser_bench bench/micro/parser_bench.cpp core/utils.cpp router/constants.cpp router/message.cpp core/logger.cpp -pthread
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../../core/utils.hpp"
+#include "../../router/message.hpp"
+
+//  Keeps the optimizer from dropping the measured work
+static volatile size_t sink = 0;
+
+//  Runs "fn" until roughly 200 ms have passed, returns nanoseconds per call
+template <typename Fn>
+static double measure(Fn fn) {
+    using clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    auto start = clock::now();
+    auto elapsed = clock::duration::zero();
+
+    do {
+        for (int i = 0; i < 64; ++i)
+            fn();
+        iterations += 64;
+        elapsed = clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(200));
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main() {
+    std::printf("%-10s %14s %14s %8s\n", "payload", "split/join ns", "header ns", "speedup");
+
+    for (size_t size : { 16, 256, 4096, 65536, 1048576 }) {
+        const std::string payload = "dashcam::frontend::1::frontend::" + std::string(size, 'x');
+
+        //  The previous path: every field is copied, then the forwarded message and the content are joined back
+        double old_ns = measure([&]() {
+            std::vector<std::string> parts = split(payload, "::");
+            std::string recipient = parts[0];
+            std::string sender_id = parts[1];
+            std::string content = join(parts, "::", 4);
+            std::string truncated_msg = join(parts, "::", 1);
+            sink += recipient.size() + sender_id.size() + content.size() + truncated_msg.size();
+        });
+
+        //  The current path: views into the payload, one copy for the forwarded message
+        double new_ns = measure([&]() {
+            MessageHeader header = parse_header(payload);
+            std::string recipient(header.recipient);
+            std::string sender_id(header.sender);
+            std::string forward(header.forward);
+            sink += recipient.size() + sender_id.size() + header.content.size() + forward.size();
+        });
+
+        std::printf("%-10zu %14.1f %14.1f %7.1fx\n", size, old_ns, new_ns, old_ns / new_ns);
+    }
+
+    return 0;
+}
@@ -0,0 +1,314 @@
+//  reconnect.cpp
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/server.hpp>
+#include <websocketpp/client.hpp>
+
+#include "constants.hpp"
+#include "reconnect.hpp"
+#include "report.hpp"
+#include "../core/backoff.hpp"
+#include "../core/utils.hpp"
+
+//  Reconnection storm --------------------------------------------------------------------------------------------------
+//  A stand-in router runs in this process on --port: a plain Websocket server that spends --handshake_cost of CPU on
+//  each handshake, as a small router does, and is blocking while it does. Once every client is connected, it drops all
+//  connections, stops listening for --reconnect milliseconds, and listens again. The clients retry like wsclient, first
+//  on a fixed interval, then with backoff, and each strategy reports how long it took until every client was back.
+
+typedef websocketpp::server<websocketpp::config::asio> server;
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+typedef std::chrono::steady_clock bench_clock;
+
+//  wsclient's handshake timeout
+static const int handshake_timeout = 2000;
+
+//  Longest wait for every client to come back
+static const auto recovery_deadline = std::chrono::seconds(300);
+
+//  Connected time before the restart
+static const auto settle_time = std::chrono::milliseconds(500);
+
+struct Peer {
+    client::connection_ptr con;
+    std::unique_ptr<asio::steady_timer> retry_timer;
+    std::unique_ptr<Backoff> backoff;
+    bool back = false;
+};
+
+static std::unique_ptr<asio::io_context> io;
+static std::unique_ptr<server> router;
+static std::unique_ptr<client> wsb;
+static std::unique_ptr<asio::steady_timer> phase_timer;
+static std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> router_connections;
+static std::vector<Peer> peers;
+static std::string ws_fullhost;
+
+static ReconnectResult* current = nullptr;
+static size_t opened = 0;
+static size_t back = 0;
+static bool restarted = false;
+static bool finished = false;
+static bool failed = false;
+static bench_clock::time_point down_time;
+static bench_clock::time_point up_time;
+
+static double ms_since(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static void after(bench_clock::duration delay, std::function<void()> fn) {
+    phase_timer->expires_after(delay);
+    phase_timer->async_wait([fn](const std::error_code& ec) {
+        if (!ec)
+            fn();
+    });
+}
+
+//  Stand-in router -----------------------------------------------------------------------------------------------------
+
+static bool router_listen() {
+    websocketpp::lib::error_code ec;
+    router->listen(asio::ip::tcp::v4(), static_cast<uint16_t>(std::stoi(port)), ec);
+    if (!ec)
+        router->start_accept(ec);
+    if (ec) {
+        log("ERROR", "The stand-in router cannot listen on port " + port + ": " + ec.message());
+        return false;
+    }
+    return true;
+}
+
+static void router_stop() {
+    websocketpp::lib::error_code ec;
+    if (router->is_listening())
+        router->stop_listening(ec);
+
+    for (const auto& hdl : router_connections)
+        router->close(hdl, websocketpp::close::status::going_away, "Restarting", ec);
+}
+
+static void init_router() {
+    router = std::make_unique<server>();
+    router->clear_access_channels(websocketpp::log::alevel::all);
+    router->clear_error_channels(websocketpp::log::elevel::all);
+    router->init_asio(io.get());
+    router->set_reuse_addr(true);
+
+    //  The work of a handshake, on the router's only thread
+    router->set_validate_handler([](websocketpp::connection_hdl) {
+        const auto until = bench_clock::now() + std::chrono::microseconds(handshake_cost);
+        while (bench_clock::now() < until) {
+        }
+        return true;
+    });
+
+    router->set_open_handler([](websocketpp::connection_hdl hdl) { router_connections.insert(hdl); });
+    router->set_close_handler([](websocketpp::connection_hdl hdl) { router_connections.erase(hdl); });
+}
+
+//  Clients -------------------------------------------------------------------------------------------------------------
+
+static void finish() {
+    if (finished)
+        return;
+    finished = true;
+
+    for (auto& peer : peers) {
+        if (peer.retry_timer)
+            peer.retry_timer->cancel();
+        websocketpp::lib::error_code ec;
+        if (peer.con && peer.con->get_state() == websocketpp::session::state::open)
+            peer.con->close(websocketpp::close::status::normal, "Benchmark finished", ec);
+    }
+    router_stop();
+
+    //  In case a close handshake doesn't complete
+    after(std::chrono::seconds(2), []() { io->stop(); });
+}
+
+static void abort_reconnect(const std::string& error) {
+    if (finished)
+        return;
+    log("ERROR", error);
+    failed = true;
+    finish();
+}
+
+static void connect(size_t i);
+
+static void retry(size_t i) {
+    if (finished)
+        return;
+
+    //  Like wsclient before backoff: every client waits the same interval, so those that lost the router together
+    //  come back together
+    const auto delay = current->strategy == "backoff" ? peers[i].backoff->next() : std::chrono::milliseconds(retry_interval);
+
+    peers[i].retry_timer->expires_after(delay);
+    peers[i].retry_timer->async_wait([i](const std::error_code& ec) {
+        if (!ec)
+            connect(i);
+    });
+}
+
+static void restart() {
+    log("LOG", "Stand-in router restarting, down for " + std::to_string(reconnect_downtime) + " ms...");
+    restarted = true;
+    down_time = bench_clock::now();
+    router_stop();
+
+    after(std::chrono::milliseconds(reconnect_downtime), []() {
+        up_time = bench_clock::now();
+        if (!router_listen()) {
+            abort_reconnect("The stand-in router didn't come back");
+            return;
+        }
+
+        after(recovery_deadline, []() {
+            log("ERROR", std::to_string(peers.size() - back) + " client(s) still not back after " +
+                std::to_string(recovery_deadline.count()) + " seconds");
+            finish();
+        });
+    });
+}
+
+static void on_open(size_t i) {
+    peers[i].backoff->reset();
+
+    if (!restarted) {
+        if (++opened < peers.size()) {
+            connect(opened);
+            return;
+        }
+        log("LOG", "Connected " + std::to_string(opened) + " clients to the stand-in router");
+        after(settle_time, restart);
+        return;
+    }
+
+    if (peers[i].back)
+        return;
+    peers[i].back = true;
+
+    if (++back == peers.size()) {
+        current->recovery_ms = ms_since(up_time);
+        current->outage_ms = ms_since(down_time);
+        current->complete = true;
+        finish();
+    }
+}
+
+static void on_lost(size_t i, bool handshake) {
+    if (finished)
+        return;
+
+    //  Before the restart, nothing should go wrong
+    if (!restarted) {
+        abort_reconnect("Connection to the stand-in router failed: " + peers[i].con->get_ec().message());
+        return;
+    }
+
+    if (handshake) {
+        if (peers[i].con->get_ec() == websocketpp::error::make_error_code(websocketpp::error::open_handshake_timeout))
+            ++current->timeouts;
+        else
+            ++current->refused;
+    }
+    retry(i);
+}
+
+static void connect(size_t i) {
+    if (finished)
+        return;
+
+    websocketpp::lib::error_code ec;
+    auto con = wsb->get_connection(ws_fullhost, ec);
+    if (ec) {
+        abort_reconnect("Connection error: " + ec.message());
+        return;
+    }
+
+    con->set_open_handshake_timeout(handshake_timeout);
+    con->set_open_handler([i](websocketpp::connection_hdl) { on_open(i); });
+    con->set_fail_handler([i](websocketpp::connection_hdl) { on_lost(i, true); });
+    con->set_close_handler([i](websocketpp::connection_hdl) { on_lost(i, false); });
+
+    if (restarted)
+        ++current->attempts;
+
+    peers[i].con = con;
+    wsb->connect(con);
+}
+
+//  Runs the scenario ---------------------------------------------------------------------------------------------------
+
+static bool run_strategy(ReconnectResult& result) {
+    current = &result;
+    opened = back = 0;
+    restarted = finished = false;
+
+    io = std::make_unique<asio::io_context>();
+    phase_timer = std::make_unique<asio::steady_timer>(*io);
+    init_router();
+
+    wsb = std::make_unique<client>();
+    wsb->clear_access_channels(websocketpp::log::alevel::all);
+    wsb->clear_error_channels(websocketpp::log::elevel::all);
+    wsb->init_asio(io.get());
+
+    peers.clear();
+    peers.resize(clients);
+    for (auto& peer : peers) {
+        peer.retry_timer = std::make_unique<asio::steady_timer>(*io);
+        peer.backoff = std::make_unique<Backoff>(retry_interval, retry_max);
+    }
+
+    log("LOG", "Running " + result.strategy + " reconnection with " + std::to_string(clients) + " clients...");
+
+    try {
+        if (!router_listen())
+            return false;
+        connect(0);
+        io->run();
+    }
+    catch (const std::exception& e) {
+        log("ERROR", "Reconnection benchmark failed: " + std::string(e.what()));
+        failed = true;
+    }
+
+    //  Connections refer to the endpoints and the event loop, so they go first
+    peers.clear();
+    router_connections.clear();
+    wsb.reset();
+    router.reset();
+    phase_timer.reset();
+    io.reset();
+    return !failed;
+}
+
+bool run_reconnect(std::vector<ReconnectResult>& results) {
+    ws_fullhost = "ws://127.0.0.1:" + port;
+
+    for (const char* strategy : { "fixed", "backoff" }) {
+        results.emplace_back();
+        results.back().strategy = strategy;
+        if (!run_strategy(results.back()))
+            return false;
+        print_reconnect_result(results.back());
+    }
+    return true;
+}
+
+void stop_reconnect() {
+    if (io)
+        asio::post(*io, []() { abort_reconnect("Benchmark interrupted"); });
+}
@@ -0,0 +1,24 @@
+//  reconnect.hpp
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//  One reconnection strategy against a restarting router
+struct ReconnectResult {
+    std::string strategy;       //  "fixed": every retry_interval, like wsclient before backoff; "backoff": core/backoff.hpp
+    double recovery_ms = 0;     //  From the router listening again until every client was connected
+    double outage_ms = 0;       //  From the router going down until every client was connected
+    uint64_t attempts = 0;      //  Connection attempts after the router went down
+    uint64_t refused = 0;       //  Attempts that found nobody listening
+    uint64_t timeouts = 0;      //  Handshakes that didn't complete within the client's timeout
+    bool complete = false;      //  Every client came back before the deadline
+};
+
+//  Connects the simulated clients to a stand-in router in this process, restarts it, and measures how long each
+//  strategy takes to bring every client back. Returns false if the scenario couldn't run.
+bool run_reconnect(std::vector<ReconnectResult>& results);
+
+//  Stops a running scenario (signal handler)
+void stop_reconnect();
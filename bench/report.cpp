@@ -0,0 +1,198 @@
+//  report.cpp
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "report.hpp"
+#include "../core/utils.hpp"
+
+static double throughput(const RunResult& result) {
+    return result.seconds > 0 ? result.received / result.seconds : 0;
+}
+
+static double us(uint64_t ns) {
+    return ns / 1000.0;
+}
+
+//  Console -------------------------------------------------------------------------------------------------------------
+
+void print_header() {
+    std::printf("%-10s %9s %8s %10s %10s %10s %9s %9s %9s %9s %9s %9s\n", "pattern", "bytes", "clients", "sent", "received",
+        "msg/s", "MB/s", "p50 us", "p99 us", "p99.9 us", "max us", "throttled");
+}
+
+void print_result(const RunResult& result) {
+    const double rate = throughput(result);
+    std::printf("%-10s %9d %8d %10llu %10llu %10.0f %9.2f %9.1f %9.1f %9.1f %9.1f %9llu\n", result.pattern.c_str(), result.size,
+        clients, static_cast<unsigned long long>(result.sent), static_cast<unsigned long long>(result.received), rate,
+        rate * result.size / 1048576.0, us(result.latency.percentile(50)), us(result.latency.percentile(99)),
+        us(result.latency.percentile(99.9)), us(result.latency.max()), static_cast<unsigned long long>(result.throttled));
+    std::fflush(stdout);
+}
+
+void print_reconnect_header() {
+    std::printf("%-10s %8s %10s %12s %12s %10s %10s %10s\n", "strategy", "clients", "down ms", "recovery ms", "outage ms",
+        "attempts", "refused", "timeouts");
+}
+
+void print_reconnect_result(const ReconnectResult& result) {
+    if (!result.complete) {
+        std::printf("%-10s %8d %10d   incomplete\n", result.strategy.c_str(), clients, reconnect_downtime);
+        std::fflush(stdout);
+        return;
+    }
+
+    std::printf("%-10s %8d %10d %12.1f %12.1f %10llu %10llu %10llu\n", result.strategy.c_str(), clients, reconnect_downtime,
+        result.recovery_ms, result.outage_ms, static_cast<unsigned long long>(result.attempts),
+        static_cast<unsigned long long>(result.refused), static_cast<unsigned long long>(result.timeouts));
+    std::fflush(stdout);
+}
+
+//  JSON lines ----------------------------------------------------------------------------------------------------------
+
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            out += c;
+    }
+    return out;
+}
+
+static std::string to_json(const RunResult& result) {
+    char numbers[512];
+    std::snprintf(numbers, sizeof(numbers),
+        "\"size\":%d,\"clients\":%d,\"rate\":%d,\"window\":%d,\"seconds\":%.3f,\"sent\":%llu,\"received\":%llu,\"errors\":%llu,"
+        "\"throttled\":%llu,\"msgs_per_s\":%.1f,\"mb_per_s\":%.3f,\"mean_us\":%.2f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,"
+        "\"max_us\":%.2f,\"router_kb_per_client\":%.2f",
+        result.size, clients, rate, window, result.seconds, static_cast<unsigned long long>(result.sent),
+        static_cast<unsigned long long>(result.received), static_cast<unsigned long long>(result.errors),
+        static_cast<unsigned long long>(result.throttled), throughput(result), throughput(result) * result.size / 1048576.0,
+        result.latency.mean() / 1000.0, us(result.latency.percentile(50)), us(result.latency.percentile(99)),
+        us(result.latency.percentile(99.9)), us(result.latency.max()), result.router_kb);
+
+    return "{\"time\":\"" + get_timestamp(true) + "\",\"label\":\"" + json_escape(label) + "\",\"host\":\"" + json_escape(ws_host) +
+        ":" + port + "\",\"pattern\":\"" + result.pattern + "\"," + numbers + "}";
+}
+
+bool write_results(const std::vector<RunResult>& results) {
+    if (output_file.empty())
+        return true;
+
+    std::ofstream out(output_file, std::ios::app);
+    if (!out) {
+        log("ERROR", "Cannot write results to " + output_file);
+        return false;
+    }
+
+    for (const auto& result : results)
+        out << to_json(result) << "\n";
+
+    log("LOG", "Results appended to " + output_file);
+    return true;
+}
+
+bool write_reconnect_results(const std::vector<ReconnectResult>& results) {
+    if (output_file.empty())
+        return true;
+
+    std::ofstream out(output_file, std::ios::app);
+    if (!out) {
+        log("ERROR", "Cannot write results to " + output_file);
+        return false;
+    }
+
+    for (const auto& result : results) {
+        char numbers[384];
+        std::snprintf(numbers, sizeof(numbers),
+            "\"clients\":%d,\"down_ms\":%d,\"handshake_us\":%d,\"retry_interval\":%d,\"retry_max\":%d,\"complete\":%s,"
+            "\"recovery_ms\":%.1f,\"outage_ms\":%.1f,\"attempts\":%llu,\"refused\":%llu,\"timeouts\":%llu",
+            clients, reconnect_downtime, handshake_cost, retry_interval, retry_max, result.complete ? "true" : "false",
+            result.recovery_ms, result.outage_ms, static_cast<unsigned long long>(result.attempts),
+            static_cast<unsigned long long>(result.refused), static_cast<unsigned long long>(result.timeouts));
+
+        out << "{\"time\":\"" << get_timestamp(true) << "\",\"label\":\"" << json_escape(label) << "\",\"scenario\":\"reconnect\","
+            << "\"strategy\":\"" << result.strategy << "\"," << numbers << "}\n";
+    }
+
+    log("LOG", "Results appended to " + output_file);
+    return true;
+}
+
+//  Baseline comparison -------------------------------------------------------------------------------------------------
+
+//  Value of a key in one of our own JSON lines (no nesting, no escaped quotes in the keys we look up)
+static std::string json_field(const std::string& line, const std::string& key) {
+    size_t pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos)
+        return "";
+
+    pos += key.size() + 3;
+    if (line[pos] == '"') {
+        const size_t end = line.find('"', pos + 1);
+        return line.substr(pos + 1, end - pos - 1);
+    }
+    return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+static double json_number(const std::string& line, const std::string& key) {
+    try {
+        return std::stod(json_field(line, key));
+    } catch (const std::exception&) {
+        return NAN;
+    }
+}
+
+bool compare_baseline(const std::vector<RunResult>& results) {
+    if (baseline_file.empty())
+        return true;
+
+    std::ifstream in(baseline_file);
+    if (!in) {
+        log("ERROR", "Cannot read baseline " + baseline_file);
+        return false;
+    }
+
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);)
+        lines.push_back(line);
+
+    bool regression = false;
+    std::printf("\n%-10s %9s %12s %12s %8s %10s %10s %8s\n", "pattern", "bytes", "base msg/s", "msg/s", "change", "base p99",
+        "p99", "change");
+
+    for (const auto& result : results) {
+
+        //  The latest run with the same parameters
+        const std::string* match = nullptr;
+        for (const auto& line : lines) {
+            if (json_field(line, "pattern") == result.pattern && json_number(line, "size") == result.size &&
+                json_number(line, "clients") == clients && json_number(line, "rate") == rate && json_number(line, "window") == window)
+                match = &line;
+        }
+
+        if (!match) {
+            std::printf("%-10s %9d   no baseline\n", result.pattern.c_str(), result.size);
+            continue;
+        }
+
+        const double base_rate = json_number(*match, "msgs_per_s");
+        const double base_p99 = json_number(*match, "p99_us");
+        const double rate_change = base_rate > 0 ? (throughput(result) / base_rate - 1) * 100 : 0;
+        const double p99_change = base_p99 > 0 ? (us(result.latency.percentile(99)) / base_p99 - 1) * 100 : 0;
+
+        //  Open loop runs send at a fixed rate, so only latency tells them apart
+        const bool slower = (rate == 0 && rate_change < -tolerance) || p99_change > tolerance;
+        regression |= slower;
+
+        std::printf("%-10s %9d %12.0f %12.0f %+7.1f%% %10.1f %10.1f %+7.1f%%%s\n", result.pattern.c_str(), result.size, base_rate,
+            throughput(result), rate_change, base_p99, us(result.latency.percentile(99)), p99_change, slower ? "  REGRESSION" : "");
+    }
+
+    return !regression;
+}
@@ -0,0 +1,22 @@
+//  report.hpp
+#pragma once
+
+#include <vector>
+
+#include "load.hpp"
+#include "reconnect.hpp"
+
+//  Console table
+void print_header();
+void print_result(const RunResult& result);
+
+//  Reconnection scenario, one line per strategy
+void print_reconnect_header();
+void print_reconnect_result(const ReconnectResult& result);
+
+//  Appends the results to --output as one JSON object per line
+bool write_results(const std::vector<RunResult>& results);
+bool write_reconnect_results(const std::vector<ReconnectResult>& results);
+
+//  Compares the results with the latest matching runs of --baseline. Returns false on a regression.
+bool compare_baseline(const std::vector<RunResult>& results);
@@ -0,0 +1,43 @@
+#!/bin/bash
+#   Soak benchmark: router memory per connection and routing latency with many clients
+#
+#   Starts a router on this machine and runs wsbench against it with each number of clients in turn: first the
+#   router's memory per connected client, then unicast at one message per second per client for a while.
+#   Build both first: "bash build.sh x64 router" and "bash build.sh x64 bench". No other router may be running, as
+#   wsrouter allows a single instance.
+#
+#   Usage: bash bench/soak.sh [platform] [clients...]       e.g. bash bench/soak.sh x64 1000 10000
+
+PLATFORM="${1:-x64}"
+shift
+COUNTS="${@:-1000 10000}"
+PORT=8099
+RESULTS="soak_results.jsonl"
+
+ROUTER="./bin/wsrouter_$PLATFORM"
+BENCH="./bin/wsbench_$PLATFORM"
+if [ ! -x "$ROUTER" ] || [ ! -x "$BENCH" ]; then
+    echo "Build $ROUTER and $BENCH first"
+    exit 1
+fi
+
+#   Both processes need a descriptor per connection
+ulimit -n 65536 2>/dev/null || ulimit -n "$(ulimit -Hn)"
+
+for CLIENTS in $COUNTS; do
+    echo "=== $CLIENTS clients ==="
+
+    "$ROUTER" -p $PORT -c $((CLIENTS + 16)) > /dev/null &
+    ROUTER_PID=$!
+    sleep 1
+
+    "$BENCH" -p $PORT -c "$CLIENTS" -m unicast -s 64 -r 1 -u 10 -d 60 --router_pid $ROUTER_PID \
+        -o "$RESULTS" -a "soak $CLIENTS"
+    STATUS=$?
+
+    kill $ROUTER_PID
+    wait $ROUTER_PID 2>/dev/null
+    [ $STATUS -ne 0 ] && exit $STATUS
+done
+
+echo "Results appended to $RESULTS"
@@ -17,8 +17,35 @@ case "${2}" in
         APP_NAME="wsclient_"
         FLAGS="-DCLIENT"
         ;;
+     bench)
+        SOURCE="bench"
+        APP_NAME="wsbench_"
+        FLAGS="-DBENCH -O2"
+        ;;
+     lib)
+        SOURCE="client"
+        APP_NAME="libwsclient_"
+        FLAGS="-DCLIENT -fPIC"
+        LIBRARY=1
+        ;;
+     deflate_bench)
+        APP_NAME="deflate_bench_"
+        MICRO="bench/micro/deflate_bench.cpp"
+        ;;
 esac
 
+#   Size of the buffer each connection reads into, e.g. READ_BUFFER=8192 bash build.sh x64 router
+if [ -n "$READ_BUFFER" ]; then
+    FLAGS="$FLAGS -DREAD_BUFFER=$READ_BUFFER"
+fi
+
+#   Optional permessage-deflate support, needs zlib for the target platform
+LIBS=""
+if [ "${3}" == "deflate" ]; then
+    FLAGS="$FLAGS -DDEFLATE"
+    LIBS="-lz"
+fi
+
 case "$PLATFORM" in
     arm)
         COMPILER="armv7hnl-openmandriva-linux-gnueabihf-g++"
@@ -56,6 +83,54 @@ case "$PLATFORM" in
         ;;
 esac
 
+#   Embeddable client: the client's modules and the C interface of lib/, as a static and a shared library
+if [ -n "$LIBRARY" ]; then
+    echo Compiling libwsclient for $PLATFORM_NAME...
+
+    OBJ_DIR="./bin/obj_$APP_NAME"
+    mkdir -p "$OBJ_DIR"
+    rm -f "$OBJ_DIR"/*.o
+
+    for FILE in ./core/*.cpp ./client/*.cpp ./lib/*.cpp; do
+        $COMPILER \
+            -std=c++17 \
+            -Wall \
+            -fmax-errors=1 \
+            -pthread \
+            -Wno-template-id-cdtor \
+            -Icore/asio/asio/include \
+            -Icore/websocketpp \
+            $FLAGS \
+            -c "$FILE" \
+            -o "$OBJ_DIR/$(basename "$(dirname "$FILE")")_$(basename "${FILE%.cpp}").o" || exit 1
+    done
+
+    ar rcs ./bin/"$APP_NAME".a "$OBJ_DIR"/*.o &&
+    $COMPILER -shared -pthread -o ./bin/"$APP_NAME".so "$OBJ_DIR"/*.o $LIBS &&
+    strip --strip-unneeded ./bin/"$APP_NAME".so &&
+    echo Completed successfully!
+    exit $?
+fi
+
+#   A micro benchmark on its own, to be copied to and run on the target device. Needs zlib for the target platform.
+if [ -n "$MICRO" ]; then
+    echo Compiling $(basename "$MICRO" .cpp) for $PLATFORM_NAME...
+
+    $COMPILER \
+        -std=c++17 \
+        -Wall \
+        -O2 \
+        -static \
+        -o ./bin/"$APP_NAME" \
+        "$MICRO" \
+        -lz \
+        &&
+
+    strip ./bin/"$APP_NAME" &&
+    echo Completed successfully!
+    exit $?
+fi
+
 echo Compiling $SOURCE for $PLATFORM_NAME...
 
 $COMPILER \
@@ -70,8 +145,9 @@ $COMPILER \
     -Icore/websocketpp \
     $FLAGS \
     "ws$SOURCE.cpp" \
-    ./core/utils.cpp \
+    ./core/*.cpp \
     ./"$SOURCE"/*.cpp \
+    $LIBS \
     &&
 
 echo "Stripping binary..." &&
@@ -4,27 +4,43 @@
 #include <fstream>
 #include <signal.h>
 #include <functional>
+#include <memory>
+#include <thread>
 
 #define ASIO_STANDALONE
 #include <asio.hpp>
 #include <websocketpp/config/asio_no_tls_client.hpp>
 #include <websocketpp/client.hpp>
 
-typedef websocketpp::client<websocketpp::config::asio_client> client;
-
+#include "config.hpp"
 #include "constants.hpp"
+#include "outbox.hpp"
+#include "../core/backoff.hpp"
+#include "../core/deflate.hpp"
+#include "../core/ring_buffer.hpp"
+#include "../core/transport.hpp"
 #include "../core/utils.hpp"
 
 //  Internal variables
 static websocketpp::connection_hdl hdl;
 static websocketpp::lib::error_code ec;
+static asio::io_context io;
 static client wsclient;
 static std::atomic<bool> quitting{false};
+static std::atomic<bool> connected{false};
+
+//  The router agreed to receive compressed messages
+static bool deflate_outgoing = false;
 
 //  ---------------------------------------------------------------------------------------------------------------------
 
+//  The client's event loop. It exists before the Websocket connection, so the pipe reader can be set up first.
 asio::io_context& get_io_service() {
-    return wsclient.get_io_service();
+    return io;
+}
+
+bool is_connected() {
+    return connected;
 }
 
 //	Shutdown ------------------------------------------------------------------------------------------------------------
@@ -32,6 +48,8 @@ void close_websocket() {
 
     if (quitting.exchange(true)) 
   	  return;
+
+    connected = false;
   	  
     wsclient.stop_perpetual();
     wsclient.stop();
@@ -51,41 +69,192 @@ void shutdown(std::string reply_to) {
 }
 
 //  Send Websocket message (thread safe) --------------------------------------------------------------------------------
+//  Producers (the io thread, the pipe reader, applications embedding the client) move their messages into a lock-free
+//  queue, and only the first message of a burst posts a handler, which drains everything queued by then. websocketpp
+//  gathers the frames queued while a write is in flight into one socket write, so a burst costs one wakeup and a
+//  couple of writes instead of one of each per message.
+
+static const size_t send_queue_size = 4096;
+static RingBuffer<OutgoingMessage> send_queue(send_queue_size);
+static std::atomic<bool> drain_posted{false};
+
+//  Returns false if the message went to the outbox (or was lost) instead. A message taken from the outbox ("replayed")
+//  goes back in front, so it keeps its place.
+static bool send_frame(const void* data, size_t size, std::string* owned, bool binary, bool replayed = false) {
+    auto msg = websocketpp::lib::make_shared<client_config::message_type>(client_config::message_type::con_msg_man_ptr(),
+        binary ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text, owned ? 0 : size);
+    if (owned)
+        msg->get_raw_payload() = std::move(*owned);
+    else
+        msg->set_payload(data, size);
+    msg->set_compressed(deflate_outgoing && size >= deflate_threshold);
+
+    websocketpp::lib::error_code ec;
+    wsclient.send(hdl, msg, ec);
+    if (!ec)
+        return true;
+
+    if (replayed)
+        outbox_push_front(std::move(msg->get_raw_payload()), binary);
+    else if (outbox_limit)
+        outbox_push(std::move(msg->get_raw_payload()), binary);
+    else
+        log("ERROR", "Websocket send failed: " + ec.message());
+    return false;
+}
+
+//  While disconnected, or while older messages are still being replayed, new ones wait in the outbox behind them
+static void send_message(const void* data, size_t size, std::string* owned, bool binary) {
+    if (outbox_limit && (!connected || !outbox_empty())) {
+        outbox_push(owned ? std::move(*owned) : std::string(static_cast<const char*>(data), size), binary);
+        return;
+    }
+    send_frame(data, size, owned, binary);
+}
+
+static void drain_send_queue() {
+    //  Cleared first: a message queued after the last pop() posts the next drain
+    drain_posted.store(false, std::memory_order_release);
+
+    OutgoingMessage message;
+    while (send_queue.pop(message))
+        send_message(message.data.data(), message.data.size(), &message.data, message.binary);
+}
+
+static void queue_message(OutgoingMessage& message) {
+    while (!send_queue.push(message)) {
+        if (quitting)
+            return;
+
+        //  Full: the io thread makes room itself, other threads wait for it
+        if (io.get_executor().running_in_this_thread())
+            drain_send_queue();
+        else
+            std::this_thread::yield();
+    }
+
+    if (!drain_posted.exchange(true, std::memory_order_acq_rel))
+        asio::post(io, drain_send_queue);
+}
+
+void send(std::string data, bool binary) {
+    OutgoingMessage message{ std::move(data), binary };
+    queue_message(message);
+}
+
+//  Several messages in one go, e.g. everything the pipe reader found in one read
+void send_batch(std::vector<std::string>&& messages) {
+    for (auto& data : messages) {
+        OutgoingMessage message{ std::move(data), false };
+        queue_message(message);
+    }
+}
+
+void send_batch(std::vector<OutgoingMessage>&& messages) {
+    for (auto& message : messages)
+        queue_message(message);
+}
+
+//  Frame straight from a buffer the caller still owns, e.g. a shared memory ring slot (io thread only)
+void send_buffer(const void* data, size_t size) {
+    send_message(data, size, nullptr, false);
+}
+
+//  Outbox replay -------------------------------------------------------------------------------------------------------
+//  After reconnecting, the outbox goes out as fast as the connection takes it: websocketpp's send queue is topped up
+//  to replay_window bytes, and checked again every millisecond.
+
+static const size_t replay_window = 4 * 1024 * 1024;
+static asio::steady_timer replay_timer(io);
+static uint64_t replayed = 0;
+
+static void replay_outbox() {
+    if (!connected || outbox_empty())
+        return;
+
+    websocketpp::lib::error_code e;
+    auto con = wsclient.get_con_from_hdl(hdl, e);
+    if (e)
+        return;
+
+    //  A connection that is going away stops the replay; the next open handler resumes it
+    std::string message;
+    bool binary;
+    while (con->get_state() == websocketpp::session::state::open && con->get_buffered_amount() < replay_window &&
+        outbox_pop(message, binary)) {
+        if (!send_frame(message.data(), message.size(), &message, binary, true))
+            return;
+        ++replayed;
+    }
 
-void send(const std::string& data) {
-    asio::post(wsclient.get_io_service(), [data]() {
-        websocketpp::lib::error_code ec;
-        wsclient.send(hdl, data, websocketpp::frame::opcode::text, ec);
-        if (ec)
-            log("ERROR", "Websocket send failed: " + ec.message());
+    if (con->get_state() != websocketpp::session::state::open)
+        return;
+
+    if (outbox_empty()) {
+        log("LOG", "Outbox replayed: " + std::to_string(replayed) + " message(s)");
+        replayed = 0;
+        return;
+    }
+
+    replay_timer.expires_after(std::chrono::milliseconds(1));
+    replay_timer.async_wait([](const asio::error_code& ec) {
+        if (!ec)
+            replay_outbox();
     });
 }
 
+//  Reconnection -------------------------------------------------------------------------------------------------------
+//  See core/backoff.hpp. The retries of a lost connection start at once and then spread out, up to retry_max apart.
+
+static asio::steady_timer reconnect_timer(io);
+static std::unique_ptr<Backoff> backoff;
+
 //  Start Websocket service ---------------------------------------------------------------------------------------------
 //  The event handler function to process incoming messages is passed as argument
 
 std::string ws_fullhost;
-bool init_websocket(std::function<void(std::string)> on_message) {
+bool init_websocket(std::function<void(std::string, bool)> on_message) {
         
 	static int retry_counter = 0;
 	std::function<void()> schedule_reconnect;
 
 	ws_fullhost = "ws://" + ws_host + ":" + port;
+    backoff = std::make_unique<Backoff>(retry_interval, retry_max);
     log("LOG", "Connecting to Websocket router at " + ws_fullhost + "...");
     
     //	STFU - no console messages from wsclient
     wsclient.clear_access_channels(websocketpp::log::alevel::all);
     wsclient.clear_error_channels(websocketpp::log::elevel::all);
     
-    wsclient.init_asio();
+    wsclient.init_asio(&io);
     wsclient.start_perpetual();
 
+    //  Socket options, once TCP is connected and before the handshake
+    wsclient.set_tcp_post_init_handler([](websocketpp::connection_hdl h) {
+        websocketpp::lib::error_code e;
+        auto con = wsclient.get_con_from_hdl(h, e);
+        if (!e)
+            tune_socket(con->get_raw_socket());
+    });
+
 	//	Connection handler      
     wsclient.set_open_handler([](websocketpp::connection_hdl h) {
         hdl = h;
+
+        //  Only compress if the router accepted the offer without restricting the client's compressor
+        std::string extensions = wsclient.get_con_from_hdl(h)->get_response_header("Sec-WebSocket-Extensions");
+        deflate_outgoing = deflate_enabled && extensions.find("permessage-deflate") != std::string::npos &&
+            extensions.find("client_no_context_takeover") == std::string::npos && extensions.find("client_max_window_bits=") == std::string::npos;
+
         log("LOG", "Connected to: " + ws_fullhost + " as " + ws_id);
-        send("router::" + ws_id + "::hello::" + ws_id + "::");
         retry_counter = 0;
+        backoff->reset();
+        connected = true;
+
+        //  The greeting goes ahead of the messages that waited for the connection
+        std::string hello = "router::" + ws_id + "::hello::" + ws_id + "::";
+        send_frame(hello.data(), hello.size(), &hello, false);
+        replay_outbox();
     });        
         
     //	Automatic reconnection routine
@@ -101,15 +270,9 @@ bool init_websocket(std::function<void(std::string)> on_message) {
 
         ++retry_counter;
 
-        //  Deprecated: legacy code for old Websocket++ version using set_timer
-        wsclient.set_timer(retry_interval, [&](websocketpp::lib::error_code const& tec) {
-
-        // For later upgrade after wsocketpp is fixed: Use ASIO steady_timer
-        
-        // auto timer = std::make_shared<asio::steady_timer>(wsclient.get_io_service());
-        // timer->expires_after(std::chrono::milliseconds(retry_interval));
-        // timer->async_wait([timer, &schedule_reconnect](const std::error_code& tec) {
-
+        //  A pending attempt is replaced, so a close and a failure of the same connection don't retry twice
+        reconnect_timer.expires_after(backoff->next());
+        reconnect_timer.async_wait([&](const asio::error_code& tec) {
             if (tec || quitting) return;
             
             websocketpp::lib::error_code err;
@@ -131,6 +294,7 @@ bool init_websocket(std::function<void(std::string)> on_message) {
     
     //	Connection closure handler
 	wsclient.set_close_handler([&](websocketpp::connection_hdl h){
+	  connected = false;
 	  if (quitting)
 		return;
 	
@@ -148,6 +312,7 @@ bool init_websocket(std::function<void(std::string)> on_message) {
 	
 	//	Connection failure handler
     wsclient.set_fail_handler([&](websocketpp::connection_hdl h){
+	  connected = false;
 	  if (quitting)
 		return;
 		
@@ -159,7 +324,7 @@ bool init_websocket(std::function<void(std::string)> on_message) {
 
     //	Incoming message handler
     wsclient.set_message_handler([on_message](websocketpp::connection_hdl, client::message_ptr msg) {
-    	on_message(msg->get_payload());
+    	on_message(msg->get_payload(), msg->get_opcode() == websocketpp::frame::opcode::binary);
     });  
 
 	//	Initialize Websocket connection
@@ -2,6 +2,8 @@
 #pragma once
 
 #include <functional>
+#include <string>
+#include <vector>
 
 #define ASIO_STANDALONE
 #include <asio/io_context.hpp>
@@ -9,7 +11,17 @@
 #include <websocketpp/client.hpp>
 
 asio::io_context& get_io_service();
-bool init_websocket(std::function<void(std::string)> on_message);
-void send(const std::string& data);
+bool is_connected();
+//  A message to send, as a binary frame if "binary" is set
+struct OutgoingMessage {
+    std::string data;
+    bool binary = false;
+};
+
+bool init_websocket(std::function<void(std::string, bool)> on_message);
+void send(std::string data, bool binary = false);
+void send_batch(std::vector<std::string>&& messages);
+void send_batch(std::vector<OutgoingMessage>&& messages);
+void send_buffer(const void* data, size_t size);
 void shutdown();
 void close_websocket();
@@ -2,6 +2,7 @@
 #include <array>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -16,12 +17,20 @@
 	#include <sys/reboot.h>
 #endif
 
+#include "../core/deflate.hpp"
+#include "../core/transport.hpp"
+#include "../core/logger.hpp"
 #include "../core/utils.hpp"
 
 #include "./asio_ws.hpp"
 #include "./constants.hpp"
+#include "./local.hpp"
+#include "./outbox.hpp"
 #include "./pipe.hpp"
 
+//  Where incoming messages go unless they are built-in commands: the input pipe, or an application embedding the client
+std::function<void(const std::string&, bool)> forward_message = write_pipe;
+
 //  Analyze command line ---------------------------------------------------------------------------------------------------------------
 bool process_args(int argc, char* argv[]) {
         for (int i = 1; i < argc; ++i) {
@@ -60,6 +69,35 @@ bool process_args(int argc, char* argv[]) {
       	if (i > 0 && (std::strcmp(argv[i-1], "--pipe_out") == 0 || std::strcmp(argv[i-1], "-po") == 0) && argv[i] && *argv[i])
               	pipe_out = argv[i];
 
+      	//  FIFO incoming pipe queue limit
+      	if (i > 0 && (std::strcmp(argv[i-1], "--pipe_queue") == 0 || std::strcmp(argv[i-1], "-pq") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 1048576);
+      	  if (!value) {
+      	    std::cout << "Invalid --pipe_queue value" << std::endl;
+      	    return false;
+      	  }
+
+      	  pipe_queue_limit = static_cast<size_t>(*value) * 1024;
+      	}
+
+      	//  FIFO pipe message framing
+      	if (i > 0 && (std::strcmp(argv[i-1], "--pipe_framing") == 0 || std::strcmp(argv[i-1], "-pf") == 0) && argv[i] && *argv[i]) {
+      	  if (std::strcmp(argv[i], "newline") == 0)
+      	    pipe_framing = PipeFraming::newline;
+      	  else if (std::strcmp(argv[i], "length") == 0)
+      	    pipe_framing = PipeFraming::length;
+      	  else if (std::strcmp(argv[i], "binary") == 0)
+      	    pipe_framing = PipeFraming::binary;
+      	  else {
+      	    std::cout << "Invalid --pipe_framing value" << std::endl;
+      	    return false;
+      	  }
+      	}
+
+      	//  Local application socket path
+      	if (i > 0 && (std::strcmp(argv[i-1], "--local_socket") == 0 || std::strcmp(argv[i-1], "-ls") == 0) && argv[i] && *argv[i])
+              	local_socket = argv[i];
+
       	//  Disable forwarding of messages to FIFO pipe
       	if (std::strcmp(argv[i], "--disable_pipe_all") == 0 || std::strcmp(argv[i], "-dp") == 0)
           	  pipe_all = false;
@@ -106,7 +144,56 @@ bool process_args(int argc, char* argv[]) {
       	  
       	  retry_interval = *value;
       	}
+
+      	//	Longest reconnection backoff
+      	if (i > 0 && (std::strcmp(argv[i-1], "--retry_max") == 0 || std::strcmp(argv[i-1], "-rm") == 0)) {
+
+      	  auto value = string_to_int(argv[i], 100, 3600000);
+      	  if (!value) {
+      	    std::cout << "Invalid --retry_max value" << std::endl;
+      	    return false;
+      	  }
+
+      	  retry_max = *value;
+      	}
           
+      	//	Outbox size in memory
+      	if (i > 0 && (std::strcmp(argv[i-1], "--outbox") == 0 || std::strcmp(argv[i-1], "-ob") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 1048576);
+      	  if (!value) {
+      	    std::cout << "Invalid --outbox value" << std::endl;
+      	    return false;
+      	  }
+
+      	  outbox_limit = static_cast<size_t>(*value) * 1024;
+      	}
+
+      	//	Outbox spill file
+      	if (i > 0 && (std::strcmp(argv[i-1], "--outbox_file") == 0 || std::strcmp(argv[i-1], "-of") == 0) && argv[i] && *argv[i])
+              	outbox_file = argv[i];
+
+      	//	Outbox spill file size
+      	if (i > 0 && (std::strcmp(argv[i-1], "--outbox_file_size") == 0 || std::strcmp(argv[i-1], "-os") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 4096);
+      	  if (!value) {
+      	    std::cout << "Invalid --outbox_file_size value" << std::endl;
+      	    return false;
+      	  }
+
+      	  outbox_file_size = static_cast<size_t>(*value) * 1024 * 1024;
+      	}
+
+      	//	Outbox message age limit
+      	if (i > 0 && (std::strcmp(argv[i-1], "--outbox_age") == 0 || std::strcmp(argv[i-1], "-oa") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 31536000);
+      	  if (!value) {
+      	    std::cout << "Invalid --outbox_age value" << std::endl;
+      	    return false;
+      	  }
+
+      	  outbox_age = *value;
+      	}
+
       	//	Websocket handshake timeout
       	if (i > 0 && (std::strcmp(argv[i-1], "--timeout") == 0 || std::strcmp(argv[i-1], "-t") == 0)) {
       	  
@@ -120,16 +207,21 @@ bool process_args(int argc, char* argv[]) {
       	}  		        
         }
 
-  return true;
+  return process_log_args(argc, argv) && process_deflate_args(argc, argv) && process_transport_args(argc, argv);
 }
 
 //	Commands processor -----------------------------------------------------------------------------------------------------------------
-void process_commands (std::string payload) {
+void process_commands (std::string payload, bool binary) {
 	//  Command format:
 	//  sender::expects_reply::reply_to::content
 
 	std::vector<std::string> parts = split(payload, "::");
 
+	//  Publications start with "@<topic>::". The pipe and local applications get the topic, the rest is a message
+	//  like any other.
+	if (parts.size() > 1 && !parts[0].empty() && parts[0][0] == '@')
+		parts.erase(parts.begin());
+
 	//  Get message parts
 	std::string sender_id = parts[0];
 
@@ -144,11 +236,22 @@ void process_commands (std::string payload) {
 	
 	std::string content = join(parts, "::", 3);
 	std::string timestamp = get_timestamp();
+
+	//  A local application addressed by name gets the message instead of this client
+	if (deliver_local(payload, content))
+		return;
+
+	//  Binary messages are never commands. They go to the input pipe as they are.
+	if (binary) {
+		if (pipe_all)
+			forward_message(payload, true);
+		return;
+	}
 		
 	//  Error
 	if (error) {
 		if (pipe_all)
-			write_pipe(payload);
+			forward_message(payload, false);
 		log("ERROR", content);
 		return;
 	}
@@ -161,7 +264,7 @@ void process_commands (std::string payload) {
 
 	//	Output incoming command unless not
 	if (pipe_all && command != "PIPE")
-		write_pipe(payload);
+		forward_message(payload, false);
 
 	//  ----------------------------------------------------------------------------------------------------------------
 	//  PING - Sends back a ping
@@ -184,6 +287,15 @@ void process_commands (std::string payload) {
 		return;
 	}
 
+	//  ----------------------------------------------------------------------------------------------------------------
+	//  STATS - Input pipe and outbox counters
+	//  ----------------------------------------------------------------------------------------------------------------
+
+	if (command == "STATS") {
+		send(reply_to + "::" + ws_id + "::0::::" + get_pipe_stats() + ":" + get_outbox_stats());
+		return;
+	}
+
 	//  ----------------------------------------------------------------------------------------------------------------
 	//  DATE - Set system date and time (latter is optional)
 	//  Example: DATE::year::month::day::hour::minute::second::timezone
@@ -1,5 +1,10 @@
 //  commands.hpp
 #pragma once
 
+#include <functional>
+#include <string>
+
+extern std::function<void(const std::string&, bool)> forward_message;
+
 bool process_args(int argc, char* argv[]);
-void process_commands(std::string payload);
+void process_commands(std::string payload, bool binary = false);
@@ -0,0 +1,35 @@
+//  config.hpp
+#pragma once
+
+#define ASIO_STANDALONE
+#include <websocketpp/concurrency/none.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include "../core/deflate.hpp"
+
+//  Websocket++ configuration of the client
+//  Everything that touches the connection runs on the io thread (other threads hand their messages over through the
+//  send queue), so Websocket++ needs no locks of its own.
+struct client_config : public websocketpp::config::asio_client {
+    typedef client_config type;
+    typedef websocketpp::concurrency::none concurrency_type;
+
+    //  READ_BUFFER=<bytes> bash build.sh ... changes it
+#ifdef READ_BUFFER
+    static const size_t connection_read_buffer_size = READ_BUFFER;
+#else
+    static const size_t connection_read_buffer_size = 16384;
+#endif
+
+    struct transport_config : public websocketpp::config::asio_client::transport_config {
+        typedef type::concurrency_type concurrency_type;
+    };
+    typedef websocketpp::transport::asio::endpoint<transport_config> transport_type;
+
+#ifdef DEFLATE
+    typedef compression::client_extension permessage_deflate_type;
+#endif
+};
+
+typedef websocketpp::client<client_config> client;
@@ -21,14 +21,31 @@ bool logging_verbose = false;
 std::string pipe_in = "/tmp/ws_in";
 std::string pipe_out = "/tmp/ws_out";
 
+//  Output pipe framing, and the longest message accepted from it
+PipeFraming pipe_framing = PipeFraming::newline;
+size_t pipe_max_message = 16 * 1024 * 1024;
+
+//  Input pipe queue
+size_t pipe_queue_limit = 1024 * 1024;
+
+//  Local application socket, off by default
+std::string local_socket = "";
+
+//  Offline outbox: 1 MB in memory, no spill file, messages expire after 10 minutes
+size_t outbox_limit = 1024 * 1024;
+std::string outbox_file = "";
+size_t outbox_file_size = 64 * 1024 * 1024;
+int outbox_age = 600;
+
 //  PID filename
 std::string pid_file = "/tmp/wsclient.pid";
 
 //  Websocket connection retries - 0 means infinite
 int retries = 10;
 
-//  Connection retry interval, milliseconds
+//  Connection retry interval, milliseconds: the base of the exponential backoff, and its cap
 int retry_interval = 1000;
+int retry_max = 30000;
 
 //  Timeout for a Websocket connection attempt, milliseconds
 int ws_handshake_timeout = 2000;
@@ -50,18 +67,38 @@ std::string help_text =
     "  --id, -i <id>                        Websocket client ID. The router will know this client by this name. Default: " + ws_id + "\n"
     "  --port, -p <port>                    Websocket remote port. Default: " + port + "\n"
     "  --retries, -r <retries>              Attempts to reconnect if Websocket connection is lost. 0 means infinite. Default: " + std::to_string(retries) + ".\n"
-    "  --retry_interval, -ri <interval>     Milliseconds to wait between reconnection attempts. Default: " + std::to_string(retry_interval) + "\n"
+    "  --retry_interval, -ri <interval>     Milliseconds of the second reconnection attempt's backoff, doubled for each further attempt. Default: " + std::to_string(retry_interval) + "\n"
+    "  --retry_max, -rm <interval>          Longest backoff between reconnection attempts, milliseconds. Default: " + std::to_string(retry_max) + "\n"
     "  --timeout, -t <timeout>              Timeout in milliseconds for reconnection attempts. Default: " + std::to_string(ws_handshake_timeout) + "\n"
+    "  --outbox, -ob <KB>                   Kilobytes of messages kept in memory while disconnected, replayed after reconnecting. 0 disables the outbox. Default: " + std::to_string(outbox_limit / 1024) + "\n"
+    "  --outbox_file, -of <path>            Spill file for messages that don't fit in memory. They survive a restart. Default: none\n"
+    "  --outbox_file_size, -os <MB>         Size of the spill file. Default: " + std::to_string(outbox_file_size / 1024 / 1024) + "\n"
+    "  --outbox_age, -oa <seconds>          Messages older than this are not replayed. Default: " + std::to_string(outbox_age) + "\n"
 
     "\nPipeline configuration:\n\n"
     "  --disable_pipe_all, -dp              Disable forwarding every incoming message to the output FIFO pipe\n"
     "  --pipe_in, -pi <pipe>                Input FIFO pipe path. Messages received with PIPE command will be written to this pipe, and other programs can read it. Default: " + pipe_in + "\n"
     "  --pipe_out, -po <pipe>               Output FIFO pipe path. Anything sent to this pipe will be sent to the WS server. Default: " + pipe_out + "\n"
+    "  --pipe_queue, -pq <KB>               Kilobytes queued for a slow reader of the input pipe or a local application before messages are dropped. Default: " + std::to_string(pipe_queue_limit / 1024) + "\n"
+    "  --pipe_framing, -pf <newline|length|binary> Messages in the output pipe end with a newline, or start with their length (4 bytes, big endian).\n"
+    "                                       binary: messages in both pipes start with their length, its highest bit set for binary frames. Default: newline\n"
+    "  --local_socket, -ls <path>           Also accept local applications on this Unix socket, each one with its own connection\n"
 
     "\nOthers:\n\n"
     "  --disable_shutdown, -ds              Disable remote shutdown. The client will still disconnect upon receiving the command." + "\n"
     "  --help, -h                           This text\n"
     "  --log, -l                            Enable logging. Default: " + (logging_enabled ? "on" : "off") + "\n"
+    "  --deflate, -z                        Compress messages with permessage-deflate, if the other side agrees (needs a 'deflate' build)\n"
+    "  --deflate_threshold, -zt <bytes>     Messages smaller than this are sent uncompressed. Default: 256\n"
+    "  --deflate_window, -zw <bits>         Compression window, 9-15 bits. Smaller uses less memory per connection. Default: 15\n"
+    "  --deflate_no_context, -zn            Compress every message on its own (less memory, worse ratio)\n"
+    "  --nagle                              Leave Nagle's algorithm on: fewer packets, but short messages may wait up to 40 ms\n"
+    "  --send_buffer, -sb <KB>              Socket send buffer. Default: the system's\n"
+    "  --receive_buffer, -rb <KB>           Socket receive buffer. Default: the system's\n"
+    "  --log_format, -lf <text|binary>      Log record format. Binary records are <u64 time (us)><u16 type length><u32 length><type><message>. Default: text\n"
+    "  --log_file, -lo <path>               Write the log to a file instead of the console\n"
+    "  --log_overflow, -lv <drop|block>     What to do when log records come faster than they can be written. Default: drop\n"
+    "  --log_buffer, -lb <records>          Number of log records buffered. Default: 4096\n"
     "  --pid, -p <path>                     File to store process ID (prevents running multiple instances). Default: " + pid_file + "\n"
     "  --version, -v                        Version information\n"
     "\n";
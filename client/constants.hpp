@@ -1,5 +1,6 @@
 // constants.hpp
 #pragma once
+#include <cstddef>
 #include <string>
 
 //  Version number and build time
@@ -25,9 +26,28 @@ extern std::string pid_file;
 extern std::string pipe_in;		//  Incoming pipe; all incoming messages will go there and the "pipe" command also writes to this
 extern std::string pipe_out;	//  Other programs may write this pipe to send out something
 
+//  Message boundaries in the output pipe: a newline after each message, or a 4 byte big endian length before it.
+//  "binary" prefixes the messages of both pipes with their length, whose highest bit marks binary Websocket frames.
+enum class PipeFraming { newline, length, binary };
+extern PipeFraming pipe_framing;
+extern size_t pipe_max_message;
+
+//  Bytes waiting for a slow reader of the input pipe before further messages are dropped
+extern size_t pipe_queue_limit;
+
+//  Unix socket for local applications (see local.cpp), empty if not used
+extern std::string local_socket;
+
+//  Offline outbox (see outbox.cpp): bytes kept in memory (0: off), spill file and its size, maximum age in seconds
+extern size_t outbox_limit;
+extern std::string outbox_file;
+extern size_t outbox_file_size;
+extern int outbox_age;
+
 //	Websocket connection retry constants
 extern int retries;
 extern int retry_interval;
+extern int retry_max;
 extern int ws_handshake_timeout;
 
 //  Shutdown enabled
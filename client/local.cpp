@@ -0,0 +1,546 @@
+// local.cpp
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
+
+#include "../core/utils.hpp"
+
+#include "constants.hpp"
+#include "asio_ws.hpp"
+#include "local.hpp"
+#include "wsring.h"
+
+//	Local application socket
+//	With --local_socket, local applications connect to a SOCK_SEQPACKET Unix socket instead of sharing the FIFO pipes.
+//	Every application has its own connection, and every send() and recv() is one whole message, so applications can't
+//	mix up each other's messages. Messages from an application are forwarded to the router, like the ones of the output
+//	pipe. Messages to "local" are commands to wsclient itself:
+//
+//	    local::hello::<name>            Incoming messages whose content starts with "<name>::" go to this application only
+//	    local::subscribe::<prefix>      Incoming messages whose content starts with <prefix> are copied to this application
+//	    local::unsubscribe::<prefix>
+//	    local::ring::<kilobytes>        Messages go through shared memory rings from now on, see wsring.h
+//
+//	Everything here runs on the io thread.
+
+//  Messages received from one application in one go, so a busy one can't starve the others
+static const int max_batch = 256;
+
+//  Polls of an empty ring before going to sleep on the eventfd
+static const int min_spin = 64;
+static const int max_spin = 8192;
+
+struct LocalApp {
+    int fd = -1;
+    std::unique_ptr<asio::posix::stream_descriptor> descriptor;
+    std::string name;
+    std::vector<std::string> subscriptions;
+
+    //  Messages waiting for a slow application
+    std::deque<std::string> queue;
+    size_t queued_bytes = 0;
+    bool write_waiting = false;
+    uint64_t dropped = 0;
+
+    //  Shared memory rings, after local::ring
+    void* ring_map = nullptr;
+    size_t ring_map_size = 0;
+    wsring* ring_out = nullptr;                                     //  Application to wsclient
+    wsring* ring_in = nullptr;                                      //  wsclient to application
+    uint32_t ring_capacity = 0;                                     //  Ours, the one in the rings can't be trusted
+    std::unique_ptr<asio::posix::stream_descriptor> ring_event;     //  Application wakes wsclient
+    int ring_in_event = -1;                                         //  wsclient wakes application
+    int spin = min_spin;
+};
+
+typedef std::shared_ptr<LocalApp> LocalAppPtr;
+
+static std::unique_ptr<asio::posix::stream_descriptor> listener;
+static std::unordered_set<LocalAppPtr> apps;
+static std::unordered_map<std::string, LocalAppPtr> app_names;
+
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+//  Takes its own reference, the caller's may point into "apps" or "app_names"
+static void close_app(LocalAppPtr app) {
+    if (!apps.erase(app))
+        return;
+
+    if (!app->name.empty())
+        app_names.erase(app->name);
+
+    if (app->dropped)
+        log("ERROR", "Local application " + (app->name.empty() ? "(unnamed)" : app->name) + " disconnected, " +
+            std::to_string(app->dropped) + " message(s) couldn't be delivered to it");
+    else
+        log("LOG", "Local application " + (app->name.empty() ? "(unnamed)" : app->name) + " disconnected");
+
+    asio::error_code ec;
+    app->descriptor->close(ec);
+
+    if (app->ring_map) {
+        app->ring_event->close(ec);
+        close(app->ring_in_event);
+        munmap(app->ring_map, app->ring_map_size);
+        app->ring_map = nullptr;
+    }
+}
+
+//  Sending to applications ---------------------------------------------------------------------------------------------
+
+static void flush_app(const LocalAppPtr& app);
+
+static void wait_app_writable(const LocalAppPtr& app) {
+    app->write_waiting = true;
+    app->descriptor->async_wait(asio::posix::stream_descriptor::wait_write, [app](const asio::error_code& ec) {
+        app->write_waiting = false;
+        if (!ec)
+            flush_app(app);
+    });
+}
+
+//  Returns false if the message has to wait
+static bool send_now(const LocalAppPtr& app, const std::string& message) {
+    for (;;) {
+        if (::send(app->fd, message.data(), message.size(), MSG_DONTWAIT | MSG_NOSIGNAL) >= 0)
+            return true;
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return false;
+
+        //  Message too long for the socket buffer, or the application is gone
+        if (errno == EMSGSIZE) {
+            log("ERROR", "Message of " + std::to_string(message.size()) + " bytes is too long for local application " + app->name);
+            ++app->dropped;
+            return true;
+        }
+        close_app(app);
+        return true;
+    }
+}
+
+static void flush_app(const LocalAppPtr& app) {
+    while (!app->queue.empty()) {
+        if (!send_now(app, app->queue.front())) {
+            wait_app_writable(app);
+            return;
+        }
+        app->queued_bytes -= app->queue.front().size();
+        app->queue.pop_front();
+    }
+}
+
+static void send_app(const LocalAppPtr& app, const std::string& message) {
+    if (app->queue.empty() && send_now(app, message))
+        return;
+
+    if (app->queued_bytes + message.size() > pipe_queue_limit) {
+        if (app->dropped++ == 0)
+            log("ERROR", "Local application " + app->name + " can't keep up, dropping messages");
+        return;
+    }
+
+    app->queue.push_back(message);
+    app->queued_bytes += message.size();
+    if (!app->write_waiting)
+        wait_app_writable(app);
+}
+
+//  Incoming messages go through the ring once there is one, command replies always through the socket
+static void deliver_app(const LocalAppPtr& app, const std::string& message) {
+    if (!app->ring_in) {
+        send_app(app, message);
+        return;
+    }
+
+    if (wsring_write_checked(app->ring_in, app->ring_capacity, app->ring_in_event, message.data(), static_cast<uint32_t>(message.size())) == 0)
+        return;
+
+    if (errno == EMSGSIZE)
+        log("ERROR", "Message of " + std::to_string(message.size()) + " bytes is too long for the ring of local application " + app->name);
+    else if (app->dropped == 0)
+        log("ERROR", "Local application " + app->name + " can't keep up, dropping messages");
+    ++app->dropped;
+}
+
+//  Shared memory rings -------------------------------------------------------------------------------------------------
+
+static void handle_local_command(const LocalAppPtr& app, const std::string& message);
+
+static void wait_ring(const LocalAppPtr& app);
+
+static void post_drain(const LocalAppPtr& app);
+
+//  The application writes the ring, so a broken or hostile one could make us read outside of it
+static void ring_corrupt(const LocalAppPtr& app) {
+    log("ERROR", "Local application " + (app->name.empty() ? "(unnamed)" : app->name) + " corrupted its ring");
+    close_app(app);
+}
+
+static void drain_ring(const LocalAppPtr& app) {
+    const void* data;
+    uint32_t size;
+    int count = 0;
+    int found = 0;
+
+    //  The frame is built straight from the slot, which is released as soon as websocketpp has its copy
+    while (count++ < max_batch && (found = wsring_peek_checked(app->ring_out, app->ring_capacity, &data, &size)) > 0) {
+        if (size >= 7 && std::memcmp(data, "local::", 7) == 0) {
+            std::string command(static_cast<const char*>(data), size);
+            wsring_release_checked(app->ring_out, size);
+            handle_local_command(app, command);
+            if (!apps.count(app))
+                return;
+        }
+        else {
+            send_buffer(data, size);
+            wsring_release_checked(app->ring_out, size);
+        }
+    }
+
+    if (found < 0) {
+        ring_corrupt(app);
+        return;
+    }
+
+    if (count > max_batch) {
+        post_drain(app);
+        return;
+    }
+
+    //  A busy application usually has the next message ready within microseconds, which is cheaper to wait for than
+    //  an eventfd round trip. The spin grows while it pays off, and shrinks while it doesn't.
+    //  On a single core the application can't run while we spin, so there it's skipped.
+    static const bool single_core = std::thread::hardware_concurrency() == 1;
+    for (int i = 0; i < app->spin && !single_core; ++i) {
+        if (wsring_peek_checked(app->ring_out, app->ring_capacity, &data, &size) != 0) {
+            app->spin = std::min(app->spin * 2, max_spin);
+            post_drain(app);
+            return;
+        }
+        wsring_relax();
+    }
+    app->spin = std::max(app->spin / 2, min_spin);
+
+    if (wsring_sleep_checked(app->ring_out, app->ring_capacity))
+        post_drain(app);
+    else
+        wait_ring(app);
+}
+
+static void post_drain(const LocalAppPtr& app) {
+    asio::post(get_io_service(), [app]() {
+        if (apps.count(app))
+            drain_ring(app);
+    });
+}
+
+static void wait_ring(const LocalAppPtr& app) {
+    app->ring_event->async_wait(asio::posix::stream_descriptor::wait_read, [app](const asio::error_code& ec) {
+        if (ec || !apps.count(app))
+            return;
+        wsring_awake(app->ring_out, app->ring_event->native_handle());
+        drain_ring(app);
+    });
+}
+
+//  Creates a memfd with both rings and an eventfd for each direction, and hands them over with SCM_RIGHTS
+static void open_ring(const LocalAppPtr& app, uint32_t capacity) {
+    const size_t map_size = 2 * wsring_bytes(capacity);
+    int fds[3] = {
+        memfd_create("wsring", MFD_CLOEXEC),
+        eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+        eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)
+    };
+    void* map = MAP_FAILED;
+
+    if (fds[0] != -1 && fds[1] != -1 && fds[2] != -1 && ftruncate(fds[0], static_cast<off_t>(map_size)) == 0)
+        map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+
+    if (map != MAP_FAILED) {
+        wsring_init(static_cast<wsring*>(map), capacity);
+        wsring_init(reinterpret_cast<wsring*>(static_cast<char*>(map) + wsring_bytes(capacity)), capacity);
+
+        std::string reply = "local::0::::ring " + std::to_string(capacity);
+        iovec iov{reply.data(), reply.size()};
+        char control[CMSG_SPACE(sizeof(fds))] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+        if (sendmsg(app->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == static_cast<ssize_t>(reply.size())) {
+            close(fds[0]);
+            app->ring_map = map;
+            app->ring_map_size = map_size;
+            app->ring_out = static_cast<wsring*>(map);
+            app->ring_in = reinterpret_cast<wsring*>(static_cast<char*>(map) + wsring_bytes(capacity));
+            app->ring_capacity = capacity;
+            app->ring_event = std::make_unique<asio::posix::stream_descriptor>(get_io_service(), fds[1]);
+            app->ring_in_event = fds[2];
+
+            log("LOG", "Local application " + (app->name.empty() ? "(unnamed)" : app->name) + " uses rings of " +
+                std::to_string(capacity / 1024) + " KB");
+            wait_ring(app);
+            return;
+        }
+    }
+
+    std::string error = strerror(errno);
+    if (map != MAP_FAILED)
+        munmap(map, map_size);
+    for (int fd : fds)
+        if (fd != -1)
+            close(fd);
+
+    log("ERROR", "Cannot create ring for local application " + app->name + ": " + error);
+    send_app(app, "local::11::::Ring unavailable: " + error);
+}
+
+//  Commands of applications --------------------------------------------------------------------------------------------
+
+static void handle_local_command(const LocalAppPtr& app, const std::string& message) {
+    std::vector<std::string> parts = split(message, "::");
+    std::string command = parts.size() > 1 ? to_upper(parts[1]) : "";
+    std::string argument = parts.size() > 2 ? join(parts, "::", 2) : "";
+
+    if (command == "HELLO") {
+        if (!is_valid_id(argument)) {
+            send_app(app, "local::4::::Invalid name: \"" + argument + "\"");
+            return;
+        }
+        if (app_names.count(argument) && app_names[argument] != app) {
+            send_app(app, "local::7::::Name \"" + argument + "\" is taken");
+            return;
+        }
+
+        if (!app->name.empty())
+            app_names.erase(app->name);
+        app->name = argument;
+        app_names[argument] = app;
+
+        log("LOG", "Local application " + argument + " registered");
+        send_app(app, "local::0::::hello " + argument);
+    }
+
+    else if (command == "SUBSCRIBE") {
+        if (std::find(app->subscriptions.begin(), app->subscriptions.end(), argument) == app->subscriptions.end())
+            app->subscriptions.push_back(argument);
+        send_app(app, "local::0::::subscribed " + argument);
+    }
+
+    else if (command == "UNSUBSCRIBE") {
+        auto it = std::find(app->subscriptions.begin(), app->subscriptions.end(), argument);
+        if (it == app->subscriptions.end()) {
+            send_app(app, "local::10::::Not subscribed to \"" + argument + "\"");
+            return;
+        }
+        app->subscriptions.erase(it);
+        send_app(app, "local::0::::unsubscribed " + argument);
+    }
+
+    else if (command == "RING") {
+        auto kilobytes = string_to_int(argument, 4, 262144);
+        if (!kilobytes) {
+            send_app(app, "local::11::::Ring unavailable: invalid size \"" + argument + "\"");
+            return;
+        }
+        if (app->ring_map) {
+            send_app(app, "local::11::::Ring unavailable: already open");
+            return;
+        }
+
+        //  Rounded up to a power of two
+        uint32_t capacity = 4096;
+        while (capacity < static_cast<uint32_t>(*kilobytes) * 1024)
+            capacity *= 2;
+        open_ring(app, capacity);
+    }
+
+    else
+        send_app(app, "local::8::::Invalid command: \"" + command + "\"");
+}
+
+//  Receiving from applications -----------------------------------------------------------------------------------------
+
+static void read_app(const LocalAppPtr& app);
+
+static void receive_app(const LocalAppPtr& app) {
+    std::vector<std::string> outgoing;
+
+    for (int i = 0; i < max_batch && apps.count(app); ++i) {
+
+        //  The size of the next message, without taking it
+        ssize_t size = ::recv(app->fd, nullptr, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (size <= 0) {
+            if (!outgoing.empty())
+                send_batch(std::move(outgoing));
+            close_app(app);
+            return;
+        }
+
+        std::string message(static_cast<size_t>(size), '\0');
+        if (::recv(app->fd, message.data(), message.size(), MSG_DONTWAIT) != size)
+            continue;
+
+        if (message.compare(0, 7, "local::") == 0)
+            handle_local_command(app, message);
+        else
+            outgoing.push_back(std::move(message));
+    }
+
+    if (!outgoing.empty())
+        send_batch(std::move(outgoing));
+
+    if (apps.count(app))
+        read_app(app);
+}
+
+static void read_app(const LocalAppPtr& app) {
+    app->descriptor->async_wait(asio::posix::stream_descriptor::wait_read, [app](const asio::error_code& ec) {
+        if (!ec)
+            receive_app(app);
+    });
+}
+
+//  Accepting applications ----------------------------------------------------------------------------------------------
+
+static void accept_apps() {
+    listener->async_wait(asio::posix::stream_descriptor::wait_read, [](const asio::error_code& ec) {
+        if (ec)
+            return;
+
+        for (;;) {
+            int fd = accept4(listener->native_handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    log("ERROR", "Cannot accept local application: " + std::string(strerror(errno)));
+                break;
+            }
+
+            auto app = std::make_shared<LocalApp>();
+            app->fd = fd;
+            app->descriptor = std::make_unique<asio::posix::stream_descriptor>(get_io_service(), fd);
+            apps.insert(app);
+            read_app(app);
+        }
+
+        accept_apps();
+    });
+}
+
+//  Delivers an incoming message to local applications ------------------------------------------------------------------
+//  Returns true if an application was addressed by name, so the message is not for this client itself.
+
+bool deliver_local(const std::string& payload, const std::string& content) {
+    if (apps.empty())
+        return false;
+
+    //  Sending may close an application, so the recipients are collected first. Each one gets the message once.
+    std::vector<LocalAppPtr> recipients;
+    auto named = app_names.find(content.substr(0, content.find("::")));
+    if (named != app_names.end())
+        recipients.push_back(named->second);
+
+    for (const auto& app : apps) {
+        if (named != app_names.end() && app == named->second)
+            continue;
+        for (const auto& prefix : app->subscriptions) {
+            if (content.compare(0, prefix.size(), prefix) == 0) {
+                recipients.push_back(app);
+                break;
+            }
+        }
+    }
+
+    for (const auto& app : recipients)
+        deliver_app(app, payload);
+
+    return named != app_names.end();
+}
+
+//  Starts the local socket server --------------------------------------------------------------------------------------
+
+bool init_local() {
+    if (local_socket.empty())
+        return true;
+
+    sockaddr_un address{};
+    if (local_socket.size() >= sizeof(address.sun_path)) {
+        log("ERROR", "Local socket path is too long: " + local_socket);
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, local_socket.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        log("ERROR", "Cannot create local socket: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    //  A socket left behind by an earlier run
+    struct stat st;
+    if (stat(local_socket.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(local_socket.c_str());
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 || listen(fd, 64) == -1) {
+        log("ERROR", "Cannot listen on local socket " + local_socket + ": " + std::string(strerror(errno)));
+        close(fd);
+        return false;
+    }
+    chmod(local_socket.c_str(), 0666);
+
+    listener = std::make_unique<asio::posix::stream_descriptor>(get_io_service(), fd);
+    accept_apps();
+
+    log("LOG", "Local applications can connect to " + local_socket);
+    return true;
+}
+
+//  Disconnects the applications, before the io_context goes away
+void close_local() {
+    while (!apps.empty())
+        close_app(*apps.begin());
+
+    if (!listener)
+        return;
+
+    asio::error_code ec;
+    listener->close(ec);
+    listener.reset();
+    unlink(local_socket.c_str());
+}
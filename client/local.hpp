@@ -0,0 +1,8 @@
+// local.hpp
+#pragma once
+
+#include <string>
+
+bool init_local();
+void close_local();
+bool deliver_local(const std::string& payload, const std::string& content);
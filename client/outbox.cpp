@@ -0,0 +1,128 @@
+// outbox.cpp
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "../core/spool.hpp"
+#include "../core/utils.hpp"
+
+#include "constants.hpp"
+#include "outbox.hpp"
+
+//	Offline outbox
+//	Messages sent while the router is unreachable wait here, and are replayed in order after the next connection. They
+//	are kept in memory up to --outbox kilobytes, then spill over to the --outbox_file spool, which also survives a
+//	restart of the client. Messages older than --outbox_age seconds are not replayed. Used on the io thread only.
+
+struct OutboxEntry {
+    std::string message;
+    int64_t time;
+    bool binary;
+};
+
+//  Spool record flag of a binary message
+static const uint32_t spool_binary = 1;
+
+static std::deque<OutboxEntry> memory;
+static size_t memory_bytes = 0;
+static Spool spool;
+
+static uint64_t outbox_dropped = 0;
+static uint64_t outbox_expired = 0;
+static auto last_drop_report = std::chrono::steady_clock::time_point();
+
+static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+bool init_outbox() {
+    if (outbox_limit == 0 || outbox_file.empty())
+        return true;
+    return spool.open(outbox_file, outbox_file_size);
+}
+
+void close_outbox() {
+    if (!memory.empty())
+        log("ERROR", std::to_string(memory.size()) + " message(s) in the outbox are lost");
+    spool.close();
+}
+
+bool outbox_empty() {
+    return memory.empty() && spool.empty();
+}
+
+void outbox_push(std::string&& message, bool binary) {
+    const int64_t time = now_ms();
+
+    //  Once messages spilled over to the file, newer ones follow them there, so the order stays intact
+    if (spool.empty() && memory_bytes + message.size() <= outbox_limit) {
+        memory_bytes += message.size();
+        memory.push_back({std::move(message), time, binary});
+        return;
+    }
+    if (spool.push(message, time, binary ? spool_binary : 0))
+        return;
+
+    ++outbox_dropped;
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_drop_report >= std::chrono::seconds(1)) {
+        last_drop_report = now;
+        log("ERROR", "Outbox is full, " + std::to_string(outbox_dropped) + " message(s) dropped so far");
+    }
+}
+
+//  A message outbox_pop() returned that couldn't be sent after all goes back in front of the others. It is allowed
+//  past the memory limit, as it was just taken out.
+void outbox_push_front(std::string&& message, bool binary) {
+    memory_bytes += message.size();
+    memory.push_front({std::move(message), now_ms(), binary});
+}
+
+//  The oldest message that isn't too old, memory first
+bool outbox_pop(std::string& message, bool& binary) {
+    const int64_t oldest = now_ms() - static_cast<int64_t>(outbox_age) * 1000;
+
+    while (!memory.empty()) {
+        OutboxEntry& entry = memory.front();
+        bool fresh = entry.time >= oldest;
+        memory_bytes -= entry.message.size();
+        if (fresh) {
+            message = std::move(entry.message);
+            binary = entry.binary;
+        }
+        else
+            ++outbox_expired;
+
+        memory.pop_front();
+        if (fresh)
+            return true;
+    }
+
+    std::string_view data;
+    int64_t time;
+    uint32_t flags;
+    while (spool.front(data, time, flags)) {
+        bool fresh = time >= oldest;
+        if (fresh) {
+            message.assign(data);
+            binary = (flags & spool_binary) != 0;
+        }
+        else
+            ++outbox_expired;
+
+        spool.pop();
+        if (fresh)
+            return true;
+    }
+    return false;
+}
+
+//  <queued>:<spooled>:<dropped>:<expired>
+std::string get_outbox_stats() {
+    return std::to_string(memory.size()) + ":" + std::to_string(spool.size()) + ":" + std::to_string(outbox_dropped) + ":" +
+        std::to_string(outbox_expired);
+}
@@ -0,0 +1,12 @@
+// outbox.hpp
+#pragma once
+
+#include <string>
+
+bool init_outbox();
+void close_outbox();
+bool outbox_empty();
+void outbox_push(std::string&& message, bool binary);
+void outbox_push_front(std::string&& message, bool binary);
+bool outbox_pop(std::string& message, bool& binary);
+std::string get_outbox_stats();
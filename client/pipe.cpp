@@ -1,4 +1,5 @@
 // pipe.cpp
+#include <algorithm>
 #include <string>
 #include <cstring>
 #include <array>
@@ -6,9 +7,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <iostream>
-#include <thread>
 #include <memory>
+#include <vector>
 #include <fcntl.h>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <deque>
+#include <sys/uio.h>
+
+#define ASIO_STANDALONE
+#include <asio.hpp>
 
 #include "../core/utils.hpp"
 
@@ -26,86 +35,304 @@ const std::shared_ptr<std::string>& get_pipe_content() {
     return pipe_content;
 }
 
-//  Watches the output pipe and sends new values to Websocket -----------------------------------------------------------------------------------------------------
+//  Reads the output pipe and sends its messages to Websocket -----------------------------------------------------------------------------------------------------
+//  The pipe is watched by the Websocket io_context, so a message is picked up as soon as it's written. Messages end with a
+//  newline, or start with their length as a 4 byte big endian number (--pipe_framing). With "binary" framing, the highest
+//  bit of the length sends the message as a binary Websocket frame, so raw bytes need no encoding. Every complete message
+//  of a read is sent at once; a partial one waits in the buffer for the rest, so large messages and concurrent writers
+//  are safe as long as each writer writes whole messages. The pipe is opened read-write, so it doesn't hit EOF between
+//  writers.
+
+static std::unique_ptr<asio::posix::stream_descriptor> pipe_reader;
+static std::vector<char> read_buffer;
+static size_t read_length = 0;
+static bool skipping = false;
+static size_t skip_remaining = 0;
+
+//  Free space made available for each read
+static const size_t read_chunk = 64 * 1024;
+
+//  Length prefix bit of binary messages with "binary" framing
+static const size_t binary_bit = size_t(1) << 31;
+
+//  Moves the complete messages of the buffer to "messages", returns the number of bytes used up
+static size_t extract_messages(std::vector<OutgoingMessage>& messages) {
+    const char* data = read_buffer.data();
+    size_t start = 0;
+
+    if (pipe_framing != PipeFraming::newline) {
+        for (;;) {
+            //  The rest of a message that was too long, which its writer goes on writing
+            if (skip_remaining) {
+                const size_t skip = std::min(skip_remaining, read_length - start);
+                skip_remaining -= skip;
+                start += skip;
+            }
+            if (read_length - start < 4)
+                break;
 
-void watch_pipe() {
+            const unsigned char* prefix = reinterpret_cast<const unsigned char*>(data + start);
+            size_t length = (size_t(prefix[0]) << 24) | (size_t(prefix[1]) << 16) | (size_t(prefix[2]) << 8) | prefix[3];
 
-    char buffer[1024];
-    int fd;
-    bool pipe_success = false;
-    
-    //  Pipe (re)opener
-    auto open_pipe =[&]() -> bool {
-	fd = open(pipe_out.c_str(), O_RDONLY);
-        
-        if (fd == -1) {
-                log("ERROR", "Error opening FIFO pipeline: " + std::string(strerror(errno)));
-                pipe_success = false;
-                return false;
+            bool binary = false;
+            if (pipe_framing == PipeFraming::binary) {
+                binary = (length & binary_bit) != 0;
+                length &= ~binary_bit;
+            }
+
+            //  Skipped as it arrives, so the next prefix is found where the writer put it
+            if (length > pipe_max_message) {
+                log("ERROR", "Message of " + std::to_string(length) + " bytes in " + pipe_out + " exceeds the limit, discarded");
+                skip_remaining = length;
+                start += 4;
+                continue;
+            }
+            if (read_length - start - 4 < length)
+                break;
+
+            messages.push_back({ std::string(data + start + 4, length), binary });
+            start += 4 + length;
         }
+        return start;
+    }
 
-        pipe_success = true;        
-        return true;
-    };
-    
-    if (!open_pipe())
-        return;
+    while (const char* newline = static_cast<const char*>(std::memchr(data + start, '\n', read_length - start))) {
+        size_t length = newline - (data + start);
+        if (length && data[start + length - 1] == '\r')
+            --length;
 
-    //	Run event loop to allow sending to the FIFO pipe
-    log("LOG", "Initializing FIFO pipe watcher loop");
-
-    while (pipe_success) {
-    
-        ssize_t bytes_read = read(fd, buffer, sizeof(buffer) - 1);
-        
-        if (bytes_read >= 0) {
-            if (bytes_read > 0) {
-                std::string incoming = std::string(buffer, bytes_read);
-                send(incoming);
-            }
+        if (skipping)
+            skipping = false;
+        else if (length)
+            messages.push_back({ std::string(data + start, length), false });
+
+        start = newline - data + 1;
+    }
+
+    //  Drop the rest of a line that would never fit
+    if (read_length - start > pipe_max_message) {
+        if (!skipping)
+            log("ERROR", "Message in " + pipe_out + " exceeds " + std::to_string(pipe_max_message) + " bytes, discarded");
+        skipping = true;
+        start = read_length;
+    }
+    return start;
+}
+
+static void read_pipe() {
+    if (read_buffer.size() - read_length < read_chunk)
+        read_buffer.resize(read_length + read_chunk);
+
+    pipe_reader->async_read_some(asio::buffer(read_buffer.data() + read_length, read_buffer.size() - read_length),
+        [](const asio::error_code& ec, size_t bytes) {
+
+        if (ec) {
+            if (ec != asio::error::operation_aborted)
+                log("ERROR", "Error reading from FIFO pipeline: " + ec.message());
+            return;
         }
-        else if (bytes_read == 0)
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
-        else {
+        read_length += bytes;
 
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::vector<OutgoingMessage> messages;
+        const size_t used = extract_messages(messages);
+        if (used) {
+            std::memmove(read_buffer.data(), read_buffer.data() + used, read_length - used);
+            read_length -= used;
+        }
+
+        //  Give back the memory of a large message
+        if (read_length == 0 && read_buffer.size() > 16 * read_chunk)
+            std::vector<char>().swap(read_buffer);
+
+        if (!messages.empty())
+            send_batch(std::move(messages));
+
+        read_pipe();
+    });
+}
+
+//  Starts reading the output pipe
+bool watch_pipe() {
+    int fd = open(pipe_out.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd == -1) {
+        log("ERROR", "Error opening FIFO pipeline: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    pipe_reader = std::make_unique<asio::posix::stream_descriptor>(get_io_service(), fd);
+    log("LOG", "Watching FIFO pipe " + pipe_out);
+    read_pipe();
+    return true;
+}
+
+//  Writes incoming messages to the input pipe, for external programs ---------------------------------------------------------------------------------------------
+//  Each message ends with a newline, or with "binary" framing, starts with its length like in the output pipe, the
+//  highest bit set if it arrived as a binary frame.
+//  The pipe stays open while a program reads it, and is reopened for the next message once the reader goes away.
+//  Messages wait in a bounded queue and are written with one writev() call when the pipe is writable, so a slow reader
+//  neither blocks the client nor loses the end of a message. What can't be written is counted (see get_pipe_stats).
+//  Only called on the io thread, like everything else here.
+
+static std::unique_ptr<asio::posix::stream_descriptor> pipe_writer;
+static std::deque<std::string> write_queue;
+static size_t write_queued_bytes = 0;
+static size_t write_offset = 0;         //  Bytes of the first queued message (and its newline) already written
+static bool write_waiting = false;
+
+static uint64_t pipe_written = 0;       //  Messages written
+static uint64_t pipe_dropped = 0;       //  Messages lost to a full queue, a write error, or a reader leaving mid-queue
+static uint64_t pipe_unread = 0;        //  Messages nobody was reading the pipe for
+static auto last_drop_report = std::chrono::steady_clock::time_point();
+
+//  A newline after each message, none when it starts with its length
+static size_t write_delimiter() {
+    return pipe_framing == PipeFraming::binary ? 0 : 1;
+}
+
+static void close_writer() {
+    if (!pipe_writer)
+        return;
+
+    asio::error_code ec;
+    pipe_writer->close(ec);
+    pipe_writer.reset();
+    write_waiting = false;
+}
+
+//  Drops are reported at most once a second, with the totals
+static void report_drop() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_drop_report < std::chrono::seconds(1))
+        return;
+
+    last_drop_report = now;
+    log("ERROR", "Input pipe " + pipe_in + " can't keep up: " + std::to_string(pipe_dropped) + " message(s) dropped so far");
+}
+
+static void flush_pipe();
+
+static void wait_writable() {
+    write_waiting = true;
+    pipe_writer->async_wait(asio::posix::stream_descriptor::wait_write, [](const asio::error_code& ec) {
+        write_waiting = false;
+        if (!ec)
+            flush_pipe();
+    });
+}
+
+static void flush_pipe() {
+    static const char newline = '\n';
+
+    while (!write_queue.empty() && pipe_writer) {
+
+        //  Every message and its newline, as far as writev() takes them
+        std::array<iovec, 512> parts;
+        size_t count = 0;
+        for (auto it = write_queue.begin(); it != write_queue.end() && count + 2 <= parts.size(); ++it) {
+            size_t skip = it == write_queue.begin() ? write_offset : 0;
+            if (skip < it->size())
+                parts[count++] = { const_cast<char*>(it->data()) + skip, it->size() - skip };
+            if (write_delimiter())
+                parts[count++] = { const_cast<char*>(&newline), 1 };
+        }
+
+        ssize_t written = ::writev(pipe_writer->native_handle(), parts.data(), count);
+        if (written < 0) {
+            if (errno == EINTR)
                 continue;
-            }            
-            else {
-                log("ERROR", "Error reading from FIFO pipeline: " + std::string(strerror(errno)));
-                    pipe_success = false;
-                close(fd);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                wait_writable();
+                return;
             }
-        }   
-    }
 
+            //  EPIPE: the reader is gone. Whatever is queued was meant for it.
+            if (errno != EPIPE)
+                log("ERROR", "Failed to write to " + pipe_in + ": " + std::string(strerror(errno)));
+            pipe_dropped += write_queue.size();
+            write_queue.clear();
+            write_queued_bytes = 0;
+            write_offset = 0;
+            close_writer();
+            report_drop();
+            return;
+        }
+
+        //  Retire what was written completely
+        size_t done = static_cast<size_t>(written);
+        while (done && !write_queue.empty()) {
+            size_t left = write_queue.front().size() + write_delimiter() - write_offset;
+            if (done < left) {
+                write_offset += done;
+                break;
+            }
+            done -= left;
+            write_queued_bytes -= write_queue.front().size() + write_delimiter();
+            write_queue.pop_front();
+            write_offset = 0;
+            ++pipe_written;
+        }
+    }
 }
 
-//  Writes the incoming messages received from outside, meant for external programs
-void write_pipe(const std::string& message) {
-			
-    int fd = open(pipe_in.c_str(), O_WRONLY | O_NONBLOCK);
-    int err = errno;
+void write_pipe(const std::string& message, bool binary) {
 
-    if (fd == -1) {
+    if (!pipe_writer) {
+        int fd = open(pipe_in.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd == -1) {
+
+            //  Nothing reads the pipe
+            if (errno == ENXIO) {
+                ++pipe_unread;
+                return;
+            }
 
-        //  Silently fail if nothing is reading the pipe
-        if (err == ENXIO)
+            log("ERROR", "Cannot open input pipe " + pipe_in + " for writing: " + std::string(strerror(errno)));
+            ++pipe_dropped;
             return;
+        }
+        pipe_writer = std::make_unique<asio::posix::stream_descriptor>(get_io_service(), fd);
+    }
 
-        log("ERROR", "Cannot open input pipe " + pipe_in + " for writing: " + std::string(strerror(err)));
+    const size_t size = write_delimiter() ? message.size() + 1 : 4 + message.size();
+    if (write_queued_bytes + size > pipe_queue_limit) {
+        ++pipe_dropped;
+        report_drop();
         return;
     }
-    
-	ssize_t bytes_written = write(fd, (message + "\n").c_str(), message.size() + 1);
 
-    if (bytes_written == -1) {
-        log("ERROR", "Failed to write to pipe_in: " + std::string(strerror(err)));
+    if (write_delimiter())
+        write_queue.push_back(message);
+    else {
+        const uint32_t length = static_cast<uint32_t>(message.size()) | (binary ? 0x80000000u : 0);
+        const char prefix[4] = { char(length >> 24), char(length >> 16), char(length >> 8), char(length) };
+        std::string framed;
+        framed.reserve(4 + message.size());
+        framed.append(prefix, 4).append(message);
+        write_queue.push_back(std::move(framed));
     }
+    write_queued_bytes += size;
 
-    close(fd);
+    //  While waiting for the pipe, messages just pile up for the next writev()
+    if (!write_waiting)
+        flush_pipe();
+}
+
+//  <written>:<dropped>:<unread>:<queued bytes>
+std::string get_pipe_stats() {
+    return std::to_string(pipe_written) + ":" + std::to_string(pipe_dropped) + ":" + std::to_string(pipe_unread) + ":" +
+        std::to_string(write_queued_bytes);
+}
+
+//  Stops reading and writing, before the io_context goes away
+void close_pipe() {
+    close_writer();
+    if (!pipe_reader)
+        return;
+
+    asio::error_code ec;
+    pipe_reader->close(ec);
+    pipe_reader.reset();
 }
 
 //  ---  Pipeline creator ----------------------------------------------------------------------------------------------
@@ -142,8 +369,9 @@ bool init_pipe() {
     if (!create_pipe(pipe_in) || !create_pipe(pipe_out))
 	return false;
 
-    //  Initialize output pipeline watcher on separate thread
-    std::thread(watch_pipe).detach();
+    //  A reader closing the input pipe must fail the write, not kill the client
+    std::signal(SIGPIPE, SIG_IGN);
 
-    return true;
+    //  Read the output pipeline on the Websocket io_context
+    return watch_pipe();
 }
@@ -6,6 +6,8 @@
 
 const std::shared_ptr<std::string>& get_pipe_content();
 bool create_pipe(std::string pipe_path);
-void write_pipe(const std::string& message);
-void watch_pipe();
+void write_pipe(const std::string& message, bool binary = false);
+std::string get_pipe_stats();
+bool watch_pipe();
+void close_pipe();
 bool init_pipe();
@@ -0,0 +1,372 @@
+/*  wsring.h
+ *
+ *  Shared memory transport between wsclient and local applications (Linux, FreeBSD 13+).
+ *  Include this header in C or C++ programs, nothing has to be linked.
+ *
+ *  An application connects to wsclient's --local_socket, then calls wsring_open(). wsclient answers with a memfd
+ *  holding two single-producer, single-consumer rings, one for each direction, and an eventfd for each. Messages are
+ *  written into the shared memory and read from it in place, so there is no syscall per message: the eventfd is only
+ *  written when the reader went to sleep, and readers spin for a moment before they do.
+ *
+ *      int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+ *      connect(fd, ...);                                   // --local_socket path
+ *      send(fd, "local::hello::camera", 20, 0);            // optional, see README
+ *
+ *      struct wsring_pair ring;
+ *      if (wsring_open(&ring, fd, 1024) == 0) {            // 1 MB for each direction
+ *          wsring_send(&ring, msg, msg_len);               // recipient::sender::0::::payload
+ *
+ *          uint32_t len;
+ *          const char* in = wsring_receive(&ring, &len, 1000);
+ *          if (in) { ...; wsring_done(&ring); }
+ *      }
+ *
+ *  Only one thread may send, and only one may receive. The socket stays usable for local:: commands.
+ */
+
+#ifndef WSRING_H
+#define WSRING_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define WSRING_MAGIC 0x31525357u        /* "WSR1" */
+#define WSRING_WRAP 0xFFFFFFFFu         /* Length of a record meaning "continue at the start" */
+#ifndef WSRING_SPIN
+#define WSRING_SPIN 4000                /* Polls before a reader goes to sleep on the eventfd, 0 on single core systems */
+#endif
+
+/*  Ring header, followed by "capacity" bytes of records. Positions only grow; the record at a position starts at
+ *  (position % capacity). A record is a 32 bit length and the message, padded to 8 bytes. The producer and the
+ *  consumer fields are on separate cache lines. */
+struct wsring {
+    uint32_t magic;
+    uint32_t capacity;                  /* Power of two */
+    uint8_t pad0[56];
+
+    uint64_t head;                      /* Producer: end of the published records */
+    uint64_t reserved;                  /* Producer: end of the record being written */
+    uint32_t reader_waiting;            /* Consumer: set while sleeping on the eventfd */
+    uint8_t pad1[44];
+
+    uint64_t tail;                      /* Consumer: start of the first unread record */
+    uint8_t pad2[56];
+};
+
+static inline unsigned char* wsring_data(struct wsring* r) {
+    return (unsigned char*)(r + 1);
+}
+
+static inline size_t wsring_bytes(uint32_t capacity) {
+    return sizeof(struct wsring) + capacity;
+}
+
+static inline uint32_t wsring_record(uint32_t len) {
+    return (4 + len + 7) & ~7u;
+}
+
+static inline void wsring_init(struct wsring* r, uint32_t capacity) {
+    memset(r, 0, sizeof(struct wsring));
+    r->magic = WSRING_MAGIC;
+    r->capacity = capacity;
+    r->reader_waiting = 1;
+}
+
+static inline void wsring_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/*  Producer -------------------------------------------------------------------------------------------------------- */
+
+/*  Space for a message of "len" bytes in a ring of "capacity" bytes, or NULL if it's full (or, from a writer that
+ *  can't trust the reader, if the positions make no sense). Fill it, then call wsring_commit(). */
+static inline void* wsring_reserve_checked(struct wsring* r, uint32_t capacity, uint32_t len) {
+    const uint32_t mask = capacity - 1;
+    const uint32_t need = wsring_record(len);
+    uint64_t head = r->head;
+    const uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+    /*  Records never wrap around the end; the rest of the ring is skipped instead */
+    uint32_t offset = (uint32_t)head & mask;
+    const uint32_t skip = need > capacity - offset ? capacity - offset : 0;
+    if ((offset & 7) != 0 || need > capacity / 2 || head + skip + need - tail > capacity)
+        return NULL;
+
+    if (skip) {
+        const uint32_t wrap = WSRING_WRAP;
+        memcpy(wsring_data(r) + offset, &wrap, 4);
+        head += skip;
+        offset = 0;
+    }
+
+    memcpy(wsring_data(r) + offset, &len, 4);
+    r->reserved = head + need;
+    return wsring_data(r) + offset + 4;
+}
+
+static inline void* wsring_reserve(struct wsring* r, uint32_t len) {
+    return wsring_reserve_checked(r, r->capacity, len);
+}
+
+/*  Publishes the reserved message. Returns nonzero if the reader sleeps and has to be woken up. */
+static inline int wsring_commit(struct wsring* r) {
+    __atomic_store_n(&r->head, r->reserved, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&r->reader_waiting, __ATOMIC_RELAXED) != 0;
+}
+
+static inline void wsring_wake(int event_fd) {
+    uint64_t one = 1;
+    ssize_t n = write(event_fd, &one, sizeof(one));
+    (void)n;
+}
+
+/*  Copies a message into a ring of "capacity" bytes. Returns -1 with errno EAGAIN if it's full, EMSGSIZE if it can
+ *  never fit. wsclient passes its own capacity, as the one in the shared memory could have been overwritten. */
+static inline int wsring_write_checked(struct wsring* r, uint32_t capacity, int event_fd, const void* data, uint32_t len) {
+    if (wsring_record(len) > capacity / 2) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    void* slot = wsring_reserve_checked(r, capacity, len);
+    if (!slot) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    memcpy(slot, data, len);
+    if (wsring_commit(r))
+        wsring_wake(event_fd);
+    return 0;
+}
+
+static inline int wsring_write(struct wsring* r, int event_fd, const void* data, uint32_t len) {
+    return wsring_write_checked(r, r->capacity, event_fd, data, len);
+}
+
+/*  Consumer -------------------------------------------------------------------------------------------------------- */
+
+/*  The next message, read in place, or NULL if there's none. Call wsring_release() when done with it. */
+static inline const void* wsring_peek(struct wsring* r, uint32_t* len) {
+    const uint32_t mask = r->capacity - 1;
+    const uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = r->tail;
+
+    while (tail != head) {
+        const uint32_t offset = (uint32_t)tail & mask;
+        uint32_t record;
+        memcpy(&record, wsring_data(r) + offset, 4);
+
+        if (record != WSRING_WRAP) {
+            *len = record;
+            return wsring_data(r) + offset + 4;
+        }
+
+        tail += r->capacity - offset;
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static inline void wsring_release(struct wsring* r) {
+    uint32_t len;
+    memcpy(&len, wsring_data(r) + ((uint32_t)r->tail & (r->capacity - 1)), 4);
+    __atomic_store_n(&r->tail, r->tail + wsring_record(len), __ATOMIC_RELEASE);
+}
+
+/*  wsring_peek() for a reader that can't trust the writer, like wsclient reading an application's ring: anything in
+ *  the shared memory may have been overwritten, so "capacity" is the reader's own and positions and lengths are checked
+ *  before they are used. Returns 1 with the next message, 0 if there's none, -1 if the ring is corrupt. Release the
+ *  message with wsring_release_checked(). */
+static inline int wsring_peek_checked(struct wsring* r, uint32_t capacity, const void** message, uint32_t* len) {
+    const uint32_t mask = capacity - 1;
+    const uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+
+    while (tail != head) {
+        const uint32_t offset = (uint32_t)tail & mask;
+        uint32_t record;
+
+        /*  Records start on 8 bytes, so their length always fits before the end */
+        if (head - tail > capacity || (offset & 7) != 0)
+            return -1;
+        memcpy(&record, wsring_data(r) + offset, 4);
+
+        if (record != WSRING_WRAP) {
+            if (record > capacity - offset - 4)
+                return -1;
+            *message = wsring_data(r) + offset + 4;
+            *len = record;
+            return 1;
+        }
+
+        tail += capacity - offset;
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/*  Releases the message of "len" bytes returned by wsring_peek_checked() */
+static inline void wsring_release_checked(struct wsring* r, uint32_t len) {
+    const uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->tail, tail + wsring_record(len), __ATOMIC_RELEASE);
+}
+
+/*  Announces that the reader goes to sleep. Returns nonzero if a message arrived meanwhile, so it must not sleep. */
+static inline int wsring_sleep(struct wsring* r) {
+    uint32_t len;
+    __atomic_store_n(&r->reader_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (wsring_peek(r, &len)) {
+        __atomic_store_n(&r->reader_waiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+/*  wsring_sleep() with wsring_peek_checked(). A corrupt ring counts as a message, so the reader looks at it. */
+static inline int wsring_sleep_checked(struct wsring* r, uint32_t capacity) {
+    const void* message;
+    uint32_t len;
+    __atomic_store_n(&r->reader_waiting, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (wsring_peek_checked(r, capacity, &message, &len) != 0) {
+        __atomic_store_n(&r->reader_waiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+    return 0;
+}
+
+static inline void wsring_awake(struct wsring* r, int event_fd) {
+    uint64_t count;
+    ssize_t n = read(event_fd, &count, sizeof(count));
+    (void)n;
+    __atomic_store_n(&r->reader_waiting, 0, __ATOMIC_RELAXED);
+}
+
+/*  The next message: spins for a while, then sleeps on the eventfd up to "timeout_ms" (-1: forever). NULL on timeout. */
+static inline const void* wsring_wait(struct wsring* r, int event_fd, uint32_t* len, int timeout_ms) {
+    const void* message;
+    int i;
+
+    for (i = 0; i < WSRING_SPIN; ++i) {
+        if ((message = wsring_peek(r, len)))
+            return message;
+        wsring_relax();
+    }
+
+    if (!wsring_sleep(r)) {
+        struct pollfd pfd = { event_fd, POLLIN, 0 };
+        poll(&pfd, 1, timeout_ms);
+    }
+    wsring_awake(r, event_fd);
+    return wsring_peek(r, len);
+}
+
+/*  Application side ------------------------------------------------------------------------------------------------ */
+
+struct wsring_pair {
+    int socket;
+    struct wsring* out;                 /* Application to wsclient */
+    struct wsring* in;                  /* wsclient to application */
+    int out_event;
+    int in_event;
+    void* map;
+    size_t map_size;
+};
+
+/*  Asks wsclient for a pair of rings of "capacity_kb" kilobytes each (rounded up to a power of two) over a connected
+ *  --local_socket. Returns 0, or -1 with errno set. */
+static inline int wsring_open(struct wsring_pair* p, int socket_fd, uint32_t capacity_kb) {
+    char request[64], reply[256];
+    int fds[3];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = { reply, sizeof(reply) - 1 };
+    struct msghdr msg;
+    struct cmsghdr* cmsg;
+    ssize_t n;
+    uint32_t capacity;
+
+    memset(p, 0, sizeof(*p));
+    n = snprintf(request, sizeof(request), "local::ring::%u", capacity_kb);
+    if (send(socket_fd, request, (size_t)n, 0) != n)
+        return -1;
+
+    /*  "local::0::::ring <capacity>" with the memfd and both eventfds, or "local::11::::<error>". Other messages that
+     *  arrive on the socket before it are skipped. */
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        n = recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        reply[n] = 0;
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(fds)) && strncmp(reply, "local::0::::ring ", 17) == 0)
+            break;
+        if (strncmp(reply, "local::11::", 11) == 0) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    capacity = (uint32_t)strtoul(reply + 17, NULL, 10);
+
+    p->map_size = 2 * wsring_bytes(capacity);
+    p->map = mmap(NULL, p->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (p->map == MAP_FAILED) {
+        close(fds[1]);
+        close(fds[2]);
+        return -1;
+    }
+
+    p->socket = socket_fd;
+    p->out = (struct wsring*)p->map;
+    p->in = (struct wsring*)((char*)p->map + wsring_bytes(capacity));
+    p->out_event = fds[1];
+    p->in_event = fds[2];
+    return 0;
+}
+
+static inline int wsring_send(struct wsring_pair* p, const void* data, uint32_t len) {
+    return wsring_write(p->out, p->out_event, data, len);
+}
+
+static inline const void* wsring_receive(struct wsring_pair* p, uint32_t* len, int timeout_ms) {
+    return wsring_wait(p->in, p->in_event, len, timeout_ms);
+}
+
+static inline void wsring_done(struct wsring_pair* p) {
+    wsring_release(p->in);
+}
+
+static inline void wsring_close(struct wsring_pair* p) {
+    if (p->map)
+        munmap(p->map, p->map_size);
+    close(p->out_event);
+    close(p->in_event);
+    memset(p, 0, sizeof(*p));
+}
+
+#endif
@@ -0,0 +1,46 @@
+//  backoff.hpp
+#ifndef BACKOFF_HPP
+#define BACKOFF_HPP
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+//  Reconnection delays -------------------------------------------------------------------------------------------------
+//  Capped exponential backoff with full jitter. The first retry after a lost connection goes out at once, as a short
+//  glitch is the most common case. After that, attempt n waits a random time between 0 and min(cap, base * 2^(n-1)),
+//  so clients that lost the same router at the same moment don't come back in the same millisecond and the router
+//  isn't flooded with handshakes while it is starting up. reset() after a successful connection.
+
+class Backoff {
+public:
+    Backoff(int base_ms, int cap_ms) : base(std::max(base_ms, 1)), cap(std::max(cap_ms, base)),
+        random(static_cast<uint32_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+            static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this))) {}
+
+    std::chrono::milliseconds next() {
+        if (attempt++ == 0)
+            return std::chrono::milliseconds(0);
+
+        //  Stop doubling once the cap is reached, so the shift can't overflow
+        int64_t ceiling = base;
+        for (int i = 1; i < attempt - 1 && ceiling < cap; ++i)
+            ceiling *= 2;
+
+        std::uniform_int_distribution<int64_t> jitter(0, std::min<int64_t>(ceiling, cap));
+        return std::chrono::milliseconds(jitter(random));
+    }
+
+    void reset() { attempt = 0; }
+    int attempts() const { return attempt; }
+
+private:
+    int base;
+    int cap;
+    int attempt = 0;
+    std::mt19937 random;
+};
+
+#endif
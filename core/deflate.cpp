@@ -0,0 +1,53 @@
+// deflate.cpp
+#include <cstring>
+#include <iostream>
+
+#include "deflate.hpp"
+#include "utils.hpp"
+
+//  permessage-deflate settings
+bool deflate_enabled = false;
+size_t deflate_threshold = 256;
+int deflate_window_bits = 15;
+bool deflate_no_context_takeover = false;
+
+//  Analyze compression arguments of the command line -------------------------------------------------------------------------------------------------------------
+bool process_deflate_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+
+        //  Compression on/off
+        if (std::strcmp(argv[i], "--deflate") == 0 || std::strcmp(argv[i], "-z") == 0) {
+            #ifndef DEFLATE
+            std::cout << "This build doesn't support compression (build it with 'deflate')" << std::endl;
+            return false;
+            #endif
+            deflate_enabled = true;
+        }
+
+        //  Smallest message to compress
+        if ((std::strcmp(argv[i-1], "--deflate_threshold") == 0 || std::strcmp(argv[i-1], "-zt") == 0) && *argv[i]) {
+            auto value = string_to_int(argv[i], 0, 16777216);
+            if (!value) {
+                std::cout << "Invalid --deflate_threshold value" << std::endl;
+                return false;
+            }
+            deflate_threshold = *value;
+        }
+
+        //  LZ77 window size
+        if ((std::strcmp(argv[i-1], "--deflate_window") == 0 || std::strcmp(argv[i-1], "-zw") == 0) && *argv[i]) {
+            auto value = string_to_int(argv[i], 9, 15);
+            if (!value) {
+                std::cout << "Invalid --deflate_window value" << std::endl;
+                return false;
+            }
+            deflate_window_bits = *value;
+        }
+
+        //  Reset the compressor after every message
+        if (std::strcmp(argv[i], "--deflate_no_context") == 0 || std::strcmp(argv[i], "-zn") == 0)
+            deflate_no_context_takeover = true;
+    }
+
+    return true;
+}
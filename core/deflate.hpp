@@ -0,0 +1,67 @@
+// deflate.hpp
+#ifndef DEFLATE_HPP
+#define DEFLATE_HPP
+
+#pragma once
+#include <cstddef>
+
+//  permessage-deflate settings (see --deflate and related arguments)
+extern bool deflate_enabled;
+extern size_t deflate_threshold;
+extern int deflate_window_bits;
+extern bool deflate_no_context_takeover;
+
+bool process_deflate_args(int argc, char* argv[]);
+
+//  Websocket++ extensions ----------------------------------------------------------------------------------------------
+//  Only available when built with zlib (build.sh ... deflate). The extensions read the settings above when a
+//  connection is created, so compression stays opt-in at runtime, and is still negotiated for each connection.
+
+#ifdef DEFLATE
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+namespace compression {
+
+struct config {};
+typedef websocketpp::extensions::permessage_deflate::enabled<config> base;
+namespace mode = websocketpp::extensions::permessage_deflate::mode;
+
+//  Router side: offers from clients are only accepted if compression is on
+class server_extension : public base {
+public:
+    server_extension() {
+        if (deflate_no_context_takeover)
+            enable_server_no_context_takeover();
+        if (deflate_window_bits < 15)
+            set_server_max_window_bits(static_cast<uint8_t>(deflate_window_bits), mode::smallest);
+    }
+
+    //  Hides base::is_implemented(), which the Websocket++ processor calls on this exact type
+    bool is_implemented() const {
+        return deflate_enabled;
+    }
+};
+
+//  Client side: Websocket++ 0.8 offers permessage-deflate, but never applies the router's answer to its own
+//  extension. It's accepted up front with default parameters instead, so compressed frames from the router can always
+//  be inflated; the client only compresses its own frames once the handshake response shows the router agreed.
+class client_extension : public base {
+public:
+    client_extension() {
+        if (!deflate_enabled)
+            return;
+
+        websocketpp::http::attribute_list defaults;
+        if (!negotiate(defaults).first)
+            init(false);
+    }
+
+    bool is_implemented() const {
+        return deflate_enabled;
+    }
+};
+
+}
+#endif
+
+#endif
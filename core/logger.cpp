@@ -0,0 +1,253 @@
+// logger.cpp
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "logger.hpp"
+#include "ring_buffer.hpp"
+#include "utils.hpp"
+
+//  Log output settings
+bool log_binary = false;
+bool log_block = false;
+std::string log_file = "";
+int log_buffer = 4096;
+
+//  A queued log line
+struct LogRecord {
+    std::chrono::system_clock::time_point time;
+    std::string type;
+    std::string msg;
+};
+
+static std::unique_ptr<RingBuffer<LogRecord>> records;
+static std::atomic<bool> running{false};
+static std::atomic<bool> writer_idle{false};
+static std::atomic<uint64_t> dropped{0};
+static std::thread writer_thread;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cv;
+static int log_fd = STDOUT_FILENO;
+
+//  Analyze logging arguments of the command line -----------------------------------------------------------------------------------------------------------------
+bool process_log_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+
+        //  Log format
+        if ((std::strcmp(argv[i-1], "--log_format") == 0 || std::strcmp(argv[i-1], "-lf") == 0) && *argv[i]) {
+            if (std::strcmp(argv[i], "binary") == 0)
+                log_binary = true;
+            else if (std::strcmp(argv[i], "text") == 0)
+                log_binary = false;
+            else {
+                std::cout << "Invalid --log_format value" << std::endl;
+                return false;
+            }
+        }
+
+        //  Log file
+        if ((std::strcmp(argv[i-1], "--log_file") == 0 || std::strcmp(argv[i-1], "-lo") == 0) && *argv[i])
+            log_file = argv[i];
+
+        //  Overflow policy
+        if ((std::strcmp(argv[i-1], "--log_overflow") == 0 || std::strcmp(argv[i-1], "-lv") == 0) && *argv[i]) {
+            if (std::strcmp(argv[i], "block") == 0)
+                log_block = true;
+            else if (std::strcmp(argv[i], "drop") == 0)
+                log_block = false;
+            else {
+                std::cout << "Invalid --log_overflow value" << std::endl;
+                return false;
+            }
+        }
+
+        //  Buffer size
+        if ((std::strcmp(argv[i-1], "--log_buffer") == 0 || std::strcmp(argv[i-1], "-lb") == 0) && *argv[i]) {
+            auto value = string_to_int(argv[i], 16, 1048576);
+            if (!value) {
+                std::cout << "Invalid --log_buffer value" << std::endl;
+                return false;
+            }
+            log_buffer = *value;
+        }
+    }
+
+    return true;
+}
+
+//  Record formatting ------------------------------------------------------------------------------------------------------------------------------------------------
+
+//  The formatted timestamp only changes once a second, so it's cached (writer thread only)
+static const char* format_time(std::chrono::system_clock::time_point time) {
+    static std::time_t cached_second = -1;
+    static char cached[20];
+
+    std::time_t tt = std::chrono::system_clock::to_time_t(time);
+    if (tt != cached_second) {
+        std::tm tm;
+        localtime_r(&tt, &tm);
+        std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_second = tt;
+    }
+    return cached;
+}
+
+static void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+        out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+//  Text:   <YYYY-mm-dd HH:MM:SS> [<type>] <message>\n
+//  Binary: <u64 microseconds since epoch><u16 type length><u32 message length><type><message>, little endian
+static void format_record(const LogRecord& record, std::string& out) {
+    if (log_binary) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(record.time.time_since_epoch()).count();
+        put_le(out, static_cast<uint64_t>(us), 8);
+        put_le(out, record.type.size(), 2);
+        put_le(out, record.msg.size(), 4);
+        out += record.type;
+        out += record.msg;
+        return;
+    }
+
+    out += format_time(record.time);
+    out += " [";
+    out += record.type;
+    out += "] ";
+    out += record.msg;
+    out += '\n';
+}
+
+static void write_all(const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(log_fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        written += n;
+    }
+}
+
+//  Writer thread ----------------------------------------------------------------------------------------------------------------------------------------------------
+static void writer() {
+    std::string batch;
+    LogRecord record;
+
+    for (;;) {
+        size_t count = 0;
+        while (count < 1024 && records->pop(record)) {
+            format_record(record, batch);
+            ++count;
+        }
+
+        uint64_t lost = dropped.exchange(0);
+        if (lost) {
+            LogRecord notice{ std::chrono::system_clock::now(), "LOG", std::to_string(lost) + " log record(s) dropped: buffer full" };
+            format_record(notice, batch);
+        }
+
+        if (!batch.empty()) {
+            write_all(batch);
+            batch.clear();
+        }
+
+        if (count)
+            continue;
+
+        if (!running)
+            return;
+
+        //  Nothing to do: sleep until a producer wakes us up. writer_idle is set before the buffer is looked at again,
+        //  and producers look at writer_idle after their push, so either we see the record or they see us idle.
+        std::unique_lock lock(writer_mutex);
+        writer_idle = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        writer_cv.wait(lock, []() { return !records->empty() || dropped || !running; });
+        writer_idle = false;
+    }
+}
+
+//  Starts the background writer -------------------------------------------------------------------------------------------------------------------------------------
+bool start_logger() {
+    if (running)
+        return true;
+
+    if (!log_file.empty()) {
+        log_fd = open(log_file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (log_fd == -1) {
+            log_fd = STDOUT_FILENO;
+            log("ERROR", "Cannot open log file " + log_file + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+
+    records = std::make_unique<RingBuffer<LogRecord>>(log_buffer);
+    running = true;
+    writer_thread = std::thread(writer);
+
+    //  Flush whatever is left when the program exits
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(stop_logger);
+        registered = true;
+    }
+    return true;
+}
+
+//  Flushes the buffer and stops the writer
+void stop_logger() {
+    if (!running.exchange(false))
+        return;
+
+    {
+        std::lock_guard lock(writer_mutex);
+        writer_cv.notify_one();
+    }
+    if (writer_thread.joinable())
+        writer_thread.join();
+
+    if (log_fd != STDOUT_FILENO) {
+        close(log_fd);
+        log_fd = STDOUT_FILENO;
+    }
+}
+
+//  Queues a record. Returns false if the writer isn't running, so the caller writes it directly.
+bool queue_log(const std::string& type, std::string& msg) {
+    if (!running)
+        return false;
+
+    LogRecord record{ std::chrono::system_clock::now(), type, std::move(msg) };
+
+    while (!records->push(record)) {
+        if (!log_block || !running) {
+            ++dropped;
+            break;
+        }
+        std::this_thread::yield();
+    }
+
+    //  Pairs with the fence of the writer going idle. Notifying under the lock means the writer is either waiting
+    //  already or still has to check its condition, so the wakeup can't get lost.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writer_idle.load(std::memory_order_relaxed)) {
+        std::lock_guard lock(writer_mutex);
+        writer_cv.notify_one();
+    }
+
+    return true;
+}
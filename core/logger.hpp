@@ -0,0 +1,29 @@
+// logger.hpp
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#pragma once
+#include <string>
+
+//  Asynchronous log backend --------------------------------------------------------------------------------------------
+//  log() hands its records to a lock-free ring buffer, and a background thread formats and writes them in batches.
+//  Until start_logger() is called (and after stop_logger()), log() writes synchronously.
+
+//  Write compact binary records instead of text lines
+extern bool log_binary;
+
+//  Block the logging thread when the buffer is full, instead of dropping the record
+extern bool log_block;
+
+//  Log file path, empty for the console
+extern std::string log_file;
+
+//  Number of records the buffer holds
+extern int log_buffer;
+
+bool process_log_args(int argc, char* argv[]);
+bool start_logger();
+void stop_logger();
+bool queue_log(const std::string& type, std::string& msg);
+
+#endif
@@ -0,0 +1,98 @@
+//  ring_buffer.hpp
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+//  Bounded lock-free queue ---------------------------------------------------------------------------------------------
+//  Any number of producers, a single consumer. Every slot carries a sequence number telling whether it's free for
+//  the producer claiming that position or filled for the consumer, so neither side ever takes a lock (D. Vyukov).
+//  The capacity is rounded up to a power of two.
+
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        mask = size - 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    //  Returns false if the buffer is full. "item" is only moved from on success.
+    bool push(T& item) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        for (;;) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+
+        slot->item = std::move(item);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //  Consumer side only. Returns false if the buffer is empty.
+    bool pop(T& item) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+            return false;
+
+        item = std::move(slot.item);
+        slot.sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    //  Consumer side only. True until the next item has been completely pushed.
+    bool empty() const {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        return slots[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    //  Approximate number of queued items, for statistics
+    size_t size() const {
+        size_t head = enqueue_pos.load(std::memory_order_relaxed);
+        size_t tail = dequeue_pos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+#endif
@@ -0,0 +1,215 @@
+// spool.cpp
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spool.hpp"
+#include "utils.hpp"
+
+static const uint32_t spool_magic = 0x4C4F5053;     //  "SPOL"
+static const uint32_t spool_version = 2;           //  1 never wrapped around, so its files are read as they are
+
+static size_t padded(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+Spool::~Spool() {
+    close();
+}
+
+bool Spool::open(const std::string& path, size_t capacity) {
+    close();
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        log("ERROR", "Cannot open spool file " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    //  An existing spool keeps its size, so its messages stay where they are
+    struct stat st;
+    bool existing = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > sizeof(Header);
+    map_size = existing ? static_cast<size_t>(st.st_size) : sizeof(Header) + padded(capacity);
+
+    if (!existing && ftruncate(fd, static_cast<off_t>(map_size)) == -1) {
+        log("ERROR", "Cannot size spool file " + path + ": " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+
+    void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        log("ERROR", "Cannot map spool file " + path + ": " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+
+    header = static_cast<Header*>(map);
+    data = static_cast<char*>(map) + sizeof(Header);
+
+    const uint64_t records = map_size - sizeof(Header);
+    if (existing && header->magic == spool_magic && (header->version == spool_version || header->version == 1) &&
+        header->capacity == records && header->head <= records && header->tail <= records && valid()) {
+        header->version = spool_version;
+
+        //  A crash right after the reader reached the wrap marker
+        if (header->tail < header->head && at_wrap(header->head))
+            header->head = 0;
+
+        if (header->count)
+            log("LOG", "Spool " + path + " holds " + std::to_string(header->count) + " message(s) from an earlier run");
+        return true;
+    }
+
+    if (existing)
+        log("ERROR", "Spool file " + path + " is damaged or of another version, starting over");
+
+    std::memset(header, 0, sizeof(Header));
+    header->magic = spool_magic;
+    header->version = spool_version;
+    header->capacity = records;
+    return true;
+}
+
+bool Spool::valid() const {
+    if (header->head % 8 || header->tail % 8 || (header->count == 0) != (header->head == header->tail))
+        return false;
+
+    bool wrapped = header->tail < header->head;
+    uint64_t at = header->head;
+    uint64_t count = 0;
+    while (at != header->tail || wrapped) {
+        if (wrapped && at_wrap(at)) {
+            at = 0;
+            wrapped = false;
+            continue;
+        }
+
+        const uint64_t end = wrapped ? header->capacity : header->tail;
+        uint32_t length;
+        if (end - at < record_header)
+            return false;
+        std::memcpy(&length, data + at, 4);
+        if (padded(record_header + length) > end - at)
+            return false;
+        at += padded(record_header + length);
+        ++count;
+    }
+    return count == header->count;
+}
+
+bool Spool::at_wrap(uint64_t at) const {
+    uint32_t length;
+    if (at == header->capacity)
+        return true;
+    std::memcpy(&length, data + at, 4);
+    return length == wrap_marker;
+}
+
+//  A record that doesn't fit before the tail: nothing after it can be trusted either
+void Spool::discard() {
+    log("ERROR", "Spool is damaged, " + std::to_string(header->count) + " message(s) discarded");
+    header->head = header->tail = 0;
+    header->count = 0;
+}
+
+void Spool::close() {
+    if (header) {
+        msync(header, map_size, MS_SYNC);
+        munmap(header, map_size);
+    }
+    if (fd != -1)
+        ::close(fd);
+
+    header = nullptr;
+    data = nullptr;
+    fd = -1;
+}
+
+bool Spool::push(std::string_view message, int64_t time, uint32_t flags) {
+    if (!header)
+        return false;
+
+    const size_t need = padded(record_header + message.size());
+    uint64_t at = header->tail;
+
+    //  While the records wrap around, new ones go between the tail and the head. They never reach the head, so a
+    //  full spool isn't mistaken for an empty one.
+    if (header->tail < header->head) {
+        if (need >= header->head - header->tail)
+            return false;
+    }
+
+    //  No room at the end: continue at the start, in front of the head, and leave a wrap marker for the reader
+    else if (header->tail + need > header->capacity) {
+        if (header->count == 0 ? need > header->capacity : need >= header->head)
+            return false;
+        if (header->tail < header->capacity)
+            std::memcpy(data + header->tail, &wrap_marker, 4);
+        at = 0;
+    }
+
+    char* record = data + at;
+    const uint32_t length = static_cast<uint32_t>(message.size());
+    std::memcpy(record, &length, 4);
+    std::memcpy(record + 4, &flags, 4);
+    std::memcpy(record + 8, &time, 8);
+    std::memcpy(record + record_header, message.data(), message.size());
+
+    //  The record is complete before the header points past it, and nothing unread is ever overwritten, so a crash
+    //  never exposes half a message
+    std::atomic_signal_fence(std::memory_order_release);
+    header->tail = at + need;
+    ++header->count;
+    return true;
+}
+
+bool Spool::front(std::string_view& message, int64_t& time) {
+    uint32_t flags;
+    return front(message, time, flags);
+}
+
+bool Spool::front(std::string_view& message, int64_t& time, uint32_t& flags) {
+    if (empty())
+        return false;
+
+    const char* record = data + header->head;
+    uint32_t length;
+    std::memcpy(&length, record, 4);
+    if (padded(record_header + length) > limit() - header->head) {
+        discard();
+        return false;
+    }
+    std::memcpy(&flags, record + 4, 4);
+    std::memcpy(&time, record + 8, 8);
+    message = std::string_view(record + record_header, length);
+    return true;
+}
+
+void Spool::pop() {
+    if (empty())
+        return;
+
+    uint32_t length;
+    std::memcpy(&length, data + header->head, 4);
+    if (padded(record_header + length) > limit() - header->head) {
+        discard();
+        return;
+    }
+    header->head += padded(record_header + length);
+
+    if (--header->count == 0)
+        header->head = header->tail = 0;
+    else if (header->tail < header->head && at_wrap(header->head))
+        header->head = 0;
+}
+
+size_t Spool::bytes() const {
+    if (!header)
+        return 0;
+    return header->tail >= header->head ? header->tail - header->head : header->capacity - header->head + header->tail;
+}
@@ -0,0 +1,69 @@
+// spool.hpp
+#ifndef SPOOL_HPP
+#define SPOOL_HPP
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//  Memory-mapped message spool -----------------------------------------------------------------------------------------
+//  A first in, first out queue of messages in a file of fixed size, mapped into memory. Messages are appended at the
+//  end and consumed from the front. When the end of the file is reached, writing continues at the beginning, in front
+//  of the unread messages, and a wrap marker tells the reader to follow. Records are never moved, so what hasn't been
+//  consumed survives a restart or a crash of the process. Each message carries a timestamp (milliseconds since the
+//  epoch) for age limits. Not thread safe.
+
+class Spool {
+public:
+    ~Spool();
+
+    //  Maps "path", creating it with "capacity" bytes if needed. Messages left by an earlier run are kept.
+    bool open(const std::string& path, size_t capacity);
+    void close();
+    bool is_open() const { return header != nullptr; }
+
+    //  Returns false if the message doesn't fit. "flags" are kept with the message for the caller.
+    bool push(std::string_view message, int64_t time, uint32_t flags = 0);
+
+    //  The oldest message, valid until the next push() or pop(). Returns false if the spool is empty. A damaged record
+    //  empties it.
+    bool front(std::string_view& message, int64_t& time);
+    bool front(std::string_view& message, int64_t& time, uint32_t& flags);
+    void pop();
+
+    bool empty() const { return !header || header->count == 0; }
+    size_t size() const { return header ? header->count : 0; }
+    size_t bytes() const;
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t capacity;          //  Bytes of records after the header
+        uint64_t head;              //  Offset of the oldest record
+        uint64_t tail;              //  Offset after the newest record, below "head" while the records wrap around
+        uint64_t count;
+    };
+
+    //  Each record: <u32 length><u32 flags><i64 time><message>, padded to 8 bytes. A length of wrap_marker ends the
+    //  records before the end of the file.
+    static const size_t record_header = 16;
+    static const uint32_t wrap_marker = 0xFFFFFFFF;
+
+    //  Walks the records of a spool left by an earlier run: each must fit before the tail, and there must be "count"
+    bool valid() const;
+    void discard();
+
+    //  Where the records starting at "head" end: the tail, or the wrap marker or end of the file while they wrap around
+    uint64_t limit() const { return header->tail < header->head ? header->capacity : header->tail; }
+    bool at_wrap(uint64_t at) const;
+
+    Header* header = nullptr;
+    char* data = nullptr;
+    size_t map_size = 0;
+    int fd = -1;
+};
+
+#endif
@@ -0,0 +1,145 @@
+//  timer_wheel.hpp
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+//  Hierarchical timer wheel --------------------------------------------------------------------------------------------
+//  Timeouts of many objects, driven by one periodic tick. Each level has 64 slots; level 0 holds what is due within
+//  64 ticks, level 1 within 64^2, and so on. When a level wraps around, the next slot of the level above is spread
+//  over the one below. Scheduling and cancelling are O(1), and a tick only touches the entries that are due (plus,
+//  once every 64 ticks, those that move down a level), no matter how many are waiting.
+//
+//  Objects derive from TimerWheel::Entry, which cancels itself when destroyed. The wheel has its own lock, and
+//  advance() calls back with it held, so an entry can't be destroyed while its callback runs: copy what is needed
+//  and act on it after advance() has returned. A derived class whose members the callback reads calls leave() in its
+//  own destructor, before those members are gone.
+
+class TimerWheel {
+public:
+    static const int levels = 4;
+    static const int slot_bits = 6;
+    static const size_t slots = size_t(1) << slot_bits;
+
+    class Entry {
+    public:
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+        ~Entry() { leave(); }
+
+        void leave() {
+            if (wheel)
+                wheel->cancel(*this);
+        }
+
+    private:
+        friend class TimerWheel;
+        TimerWheel* wheel = nullptr;
+        Entry* next = nullptr;
+        Entry** pprev = nullptr;            //  The pointer pointing at this entry, nullptr if not scheduled
+        uint64_t due = 0;
+    };
+
+    //  Runs an entry "ticks" ticks from now, at least 1. A scheduled entry is moved.
+    void schedule(Entry& entry, uint64_t ticks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unlink(entry);
+        entry.wheel = this;
+        entry.due = now + (ticks ? ticks : 1);
+        link(entry);
+    }
+
+    void cancel(Entry& entry) {
+        std::lock_guard<std::mutex> lock(mutex);
+        unlink(entry);
+    }
+
+    //  One tick. "expired(entry)" is called for each entry that is due, and returns the ticks until it runs again,
+    //  or 0 to stop.
+    template <typename Fn>
+    void advance(Fn&& expired) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++now;
+
+        //  Slot 0 of a level comes around: move the next slot of the level above down
+        for (int level = 1; level < levels; ++level) {
+            if ((now >> ((level - 1) * slot_bits)) & (slots - 1))
+                break;
+            Entry* entry = take(wheel_slots[level][(now >> (level * slot_bits)) & (slots - 1)]);
+            while (entry) {
+                Entry* next = entry->next;
+                link(*entry);
+                entry = next;
+            }
+        }
+
+        Entry* entry = take(wheel_slots[0][now & (slots - 1)]);
+        while (entry) {
+            Entry* next = entry->next;
+            if (uint64_t again = expired(*entry)) {
+                entry->due = now + again;
+                link(*entry);
+            }
+            entry = next;
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+private:
+    void link(Entry& entry) {
+        const uint64_t ahead = entry.due > now ? entry.due - now : 0;
+        int level = 0;
+        while (level < levels - 1 && ahead >= (uint64_t(1) << ((level + 1) * slot_bits)))
+            ++level;
+
+        //  Further out than the top level reaches: park it in its last slot, it comes down again from there
+        uint64_t due = entry.due;
+        if (ahead >= (uint64_t(1) << (levels * slot_bits)))
+            due = now + (uint64_t(1) << (levels * slot_bits)) - 1;
+
+        Entry*& head = wheel_slots[level][(due >> (level * slot_bits)) & (slots - 1)];
+        entry.next = head;
+        if (head)
+            head->pprev = &entry.next;
+        entry.pprev = &head;
+        head = &entry;
+        ++count;
+    }
+
+    void unlink(Entry& entry) {
+        if (!entry.pprev)
+            return;
+        *entry.pprev = entry.next;
+        if (entry.next)
+            entry.next->pprev = entry.pprev;
+        entry.next = nullptr;
+        entry.pprev = nullptr;
+        --count;
+    }
+
+    //  Empties a slot, returning its entries as a list linked by "next"
+    Entry* take(Entry*& head) {
+        Entry* first = head;
+        head = nullptr;
+        for (Entry* entry = first; entry; entry = entry->next) {
+            entry->pprev = nullptr;
+            --count;
+        }
+        return first;
+    }
+
+    mutable std::mutex mutex;
+    Entry* wheel_slots[levels][slots] = {};
+    uint64_t now = 0;
+    size_t count = 0;
+};
+
+#endif
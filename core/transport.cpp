@@ -0,0 +1,67 @@
+// transport.cpp
+#include <cstring>
+#include <iostream>
+
+#include "transport.hpp"
+#include "utils.hpp"
+
+//  TCP settings
+bool tcp_no_delay = true;
+size_t socket_send_buffer = 0;
+size_t socket_receive_buffer = 0;
+
+//  Analyze TCP arguments of the command line ---------------------------------------------------------------------------------------------------------------------
+bool process_transport_args(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+
+        //  Nagle's algorithm back on, for fewer packets at the cost of latency
+        if (std::strcmp(argv[i], "--nagle") == 0)
+            tcp_no_delay = false;
+
+        //  Kernel send buffer of each connection
+        if ((std::strcmp(argv[i-1], "--send_buffer") == 0 || std::strcmp(argv[i-1], "-sb") == 0) && *argv[i]) {
+            auto value = string_to_int(argv[i], 0, 65536);
+            if (!value) {
+                std::cout << "Invalid --send_buffer value" << std::endl;
+                return false;
+            }
+            socket_send_buffer = static_cast<size_t>(*value) * 1024;
+        }
+
+        //  Kernel receive buffer of each connection
+        if ((std::strcmp(argv[i-1], "--receive_buffer") == 0 || std::strcmp(argv[i-1], "-rb") == 0) && *argv[i]) {
+            auto value = string_to_int(argv[i], 0, 65536);
+            if (!value) {
+                std::cout << "Invalid --receive_buffer value" << std::endl;
+                return false;
+            }
+            socket_receive_buffer = static_cast<size_t>(*value) * 1024;
+        }
+    }
+
+    return true;
+}
+
+//  Socket options ------------------------------------------------------------------------------------------------------------------------------------------------
+//  Failures are logged, not fatal: the connection works without them, only slower.
+void tune_socket(asio::ip::tcp::socket& socket) {
+    asio::error_code ec;
+
+    if (tcp_no_delay) {
+        socket.set_option(asio::ip::tcp::no_delay(true), ec);
+        if (ec)
+            log("ERROR", "Cannot disable Nagle's algorithm: " + ec.message());
+    }
+
+    if (socket_send_buffer) {
+        socket.set_option(asio::socket_base::send_buffer_size(static_cast<int>(socket_send_buffer)), ec);
+        if (ec)
+            log("ERROR", "Cannot set the socket send buffer: " + ec.message());
+    }
+
+    if (socket_receive_buffer) {
+        socket.set_option(asio::socket_base::receive_buffer_size(static_cast<int>(socket_receive_buffer)), ec);
+        if (ec)
+            log("ERROR", "Cannot set the socket receive buffer: " + ec.message());
+    }
+}
@@ -0,0 +1,22 @@
+// transport.hpp
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#pragma once
+#include <cstddef>
+
+#define ASIO_STANDALONE
+#include <asio/ip/tcp.hpp>
+
+//  TCP settings of Websocket connections (see --nagle and the socket buffer arguments)
+extern bool tcp_no_delay;
+extern size_t socket_send_buffer;           //  Bytes, 0: the system's default
+extern size_t socket_receive_buffer;
+
+bool process_transport_args(int argc, char* argv[]);
+
+//  Applies the settings above to a connected socket. Nagle's algorithm is off by default: a short message is
+//  written at once instead of waiting up to 40 ms for the peer's delayed ACK of the previous one.
+void tune_socket(asio::ip::tcp::socket& socket);
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cctype>
@@ -8,7 +9,8 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <sys/resource.h>
 #include <sys/time.h>
 #include <unordered_map>
 #include <filesystem>
@@ -19,10 +21,13 @@
   #include "../router/constants.hpp"
 #elif defined(CLIENT)
   #include "../client/constants.hpp"
+#elif defined(BENCH)
+  #include "../bench/constants.hpp"
 #else
-  #error "No build target defined ('ROUTER' or 'CLIENT')"
+  #error "No build target defined ('ROUTER', 'CLIENT' or 'BENCH')"
 #endif
 
+#include "logger.hpp"
 #include "utils.hpp"
 
 //  Reads the contents of a directory -----------------------------------------------------------------------------------------------------------------------------
@@ -78,12 +83,21 @@ std::string join(const std::vector<std::string>& parts, const std::string& delim
 
 //  Logger -------------------------------------------------------------------------------------------------------------------------------------------------------
 //  Prints a log line (if logging is enabled)
-void log(const std::string& type, const std::string& msg) {
-    if (logging_enabled) {
-        std::cout << get_timestamp(true) << " [" << type << "] " << msg << std::endl;
+//  Lines go to the asynchronous writer once it runs (see logger.cpp). Until then, the line is assembled first
+//  and written in one go, so lines of concurrent io threads don't interleave.
+void log(const std::string& type, std::string&& msg) {
+    if (logging_enabled && !queue_log(type, msg)) {
+        std::string line = get_timestamp(true) + " [" + type + "] " + msg + "\n";
+        std::cout << line << std::flush;
     }
 }
 
+//  Copies the message only if it's going to be logged
+void log(const std::string& type, const std::string& msg) {
+    if (logging_enabled)
+        log(type, std::string(msg));
+}
+
 //  Sets the system date and time --------------------------------------------------------------------------------------------------------------------------------
 bool set_datetime(std::vector<std::string> date_parts) {
 
@@ -183,6 +197,38 @@ bool single_instance() {
     return true;
 }
 
+//  Open file limit  ---------------------------------------------------------------------------------------------------------------------------------------------
+//  Every connection is a file descriptor, and the usual soft limit of 1024 is far below what a busy router needs. Raises the soft limit to "needed", and the
+//  hard limit as well if the process is allowed to. Returns false if the limit stays lower.
+bool raise_file_limit(size_t needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return false;
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur >= needed)
+        return true;
+
+    struct rlimit wanted = limit;
+    wanted.rlim_cur = needed;
+    if (wanted.rlim_max != RLIM_INFINITY && wanted.rlim_max < needed)
+        wanted.rlim_max = needed;
+
+    //  Without the privilege to raise the hard limit, go as far as it allows
+    if (setrlimit(RLIMIT_NOFILE, &wanted) != 0) {
+        wanted.rlim_cur = std::min<rlim_t>(needed, limit.rlim_max);
+        wanted.rlim_max = limit.rlim_max;
+        if (wanted.rlim_cur > limit.rlim_cur)
+            setrlimit(RLIMIT_NOFILE, &wanted);
+    }
+
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < needed) {
+        log("WARNING", "Open file limit is " + std::to_string(limit.rlim_cur) + ", " + std::to_string(needed) +
+            " needed. Raise it with 'ulimit -n' or LimitNOFILE= in the service file.");
+        return false;
+    }
+    return true;
+}
+
 //  String conversion to uppercase  ----------------------------------------------------------------------------------------------------------
 std::string to_upper(const std::string& s) {
     std::string out = s;
@@ -218,6 +264,22 @@ std::optional<int> string_to_int(
 }
 
 //  Validates a client ID -----------------------------------------------------------------------------------------------------------------------------
-bool is_valid_id(const std::string& id) {
-    return !id.empty() && std::regex_match(id, std::regex("^[a-zA-Z0-9]+$"));
+//  IDs are alphanumeric. The character class is a table built at compile time, so a check is one lookup per character.
+static constexpr std::array<bool, 256> id_chars = []() {
+    std::array<bool, 256> table{};
+    for (int c = '0'; c <= '9'; ++c) table[c] = true;
+    for (int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+    for (int c = 'a'; c <= 'z'; ++c) table[c] = true;
+    return table;
+}();
+
+bool is_valid_id(std::string_view id) {
+    if (id.empty())
+        return false;
+
+    for (unsigned char c : id) {
+        if (!id_chars[c])
+            return false;
+    }
+    return true;
 }
@@ -0,0 +1,247 @@
+//  api.cpp
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define ASIO_STANDALONE
+#include <asio/post.hpp>
+
+#include "../core/logger.hpp"
+#include "../core/utils.hpp"
+
+#include "../client/asio_ws.hpp"
+#include "../client/commands.hpp"
+#include "../client/constants.hpp"
+#include "../client/outbox.hpp"
+
+#include "wsclient.h"
+
+//	Embedding API
+//	The functions of wsclient.h on top of the client's own modules. The connection and its reconnection logic run on a
+//	thread of their own, exactly as in the wsclient program, and incoming messages go to the application's callback
+//	instead of the input pipe.
+
+struct Request {
+    std::string recipient;
+    bool done = false;
+    bool failed = false;
+    std::string reply;
+};
+
+static std::thread io_thread;
+static std::atomic<bool> started{false};
+static std::atomic<bool> running{false};
+
+static wsclient_receive_fn receive_fn = nullptr;
+static void* receive_user = nullptr;
+static bool builtin_commands = false;
+
+//  Requests waiting for a reply, oldest first
+static std::mutex requests_mutex;
+static std::condition_variable requests_done;
+static std::deque<std::shared_ptr<Request>> requests;
+
+//  Incoming messages ---------------------------------------------------------------------------------------------------
+//  Format: sender::expects_reply::reply_to::content, publications with "@topic::" in front
+
+static size_t content_start(const std::string& payload) {
+    size_t pos = 0;
+    for (int i = payload[0] == '@' ? 0 : 1; i < 4; ++i) {
+        pos = payload.find("::", pos);
+        if (pos == std::string::npos)
+            return payload.size();
+        pos += 2;
+    }
+    return pos;
+}
+
+static void deliver(const std::string& payload, bool) {
+    if (!receive_fn)
+        return;
+
+    //  The sender of a publication is "@<topic>::<sender>"
+    size_t start = content_start(payload);
+    size_t end = payload.find("::", payload[0] == '@' ? payload.find("::") + 2 : 0);
+    std::string sender = payload.substr(0, end);
+    receive_fn(sender.c_str(), payload.c_str() + start, payload.size() - start, receive_user);
+}
+
+//  The next message of a client someone waits for is the reply. The router's error 3 fails requests to a client that
+//  isn't connected: router::3::::Client "<id>" is not connected to server
+static bool complete_request(const std::string& payload) {
+    std::lock_guard<std::mutex> lock(requests_mutex);
+    if (requests.empty())
+        return false;
+
+    size_t start = content_start(payload);
+    std::string recipient = payload.substr(0, payload.find("::"));
+    bool failed = false;
+
+    if (recipient == "router" && payload.compare(0, 11, "router::3::") == 0 && payload.compare(start, 8, "Client \"") == 0) {
+        recipient = payload.substr(start + 8, payload.find('"', start + 8) - start - 8);
+        failed = true;
+    }
+
+    for (auto it = requests.begin(); it != requests.end(); ++it) {
+        if ((*it)->recipient != recipient)
+            continue;
+
+        (*it)->done = true;
+        (*it)->failed = failed;
+        (*it)->reply = payload.substr(start);
+        requests.erase(it);
+        requests_done.notify_all();
+        return true;
+    }
+    return false;
+}
+
+static void on_message(std::string payload, bool binary) {
+    if (complete_request(payload))
+        return;
+
+    if (builtin_commands)
+        process_commands(payload, binary);
+    else
+        deliver(payload, binary);
+}
+
+//  C interface ---------------------------------------------------------------------------------------------------------
+
+//  Fields an application built against an older header doesn't know keep their defaults
+#define HAS_OPTION(options, field) ((options)->size >= offsetof(wsclient_options, field) + sizeof((options)->field))
+
+int wsclient_connect(const wsclient_options* options, wsclient_receive_fn receive, void* user) {
+    //  The client's modules can't be restarted
+    if (!options || started.exchange(true))
+        return WSCLIENT_ERROR;
+
+    if (HAS_OPTION(options, host) && options->host)
+        ws_host = options->host;
+    if (HAS_OPTION(options, port) && options->port)
+        port = options->port;
+    if (HAS_OPTION(options, id) && options->id)
+        ws_id = options->id;
+    if (HAS_OPTION(options, retries))
+        retries = options->retries;
+    if (HAS_OPTION(options, retry_interval))
+        retry_interval = options->retry_interval;
+    if (HAS_OPTION(options, handshake_timeout))
+        ws_handshake_timeout = options->handshake_timeout;
+    if (HAS_OPTION(options, log))
+        logging_enabled = options->log != 0;
+    if (HAS_OPTION(options, commands))
+        builtin_commands = options->commands != 0;
+    if (HAS_OPTION(options, retry_max) && options->retry_max > 0)
+        retry_max = options->retry_max;
+
+    if (!is_valid_id(ws_id) || !string_to_int(port, 0, 65535)) {
+        log("ERROR", "Invalid client ID or port");
+        started = false;
+        return WSCLIENT_ERROR;
+    }
+
+    receive_fn = receive;
+    receive_user = user;
+
+    //  Without local applications or pipes, everything that isn't a built-in command goes to the callback
+    pipe_all = true;
+    forward_message = deliver;
+
+    running = true;
+    io_thread = std::thread([]() {
+        init_websocket(on_message);
+        close_outbox();
+        running = false;
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ws_handshake_timeout);
+    while (!is_connected() && running && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    if (is_connected())
+        return WSCLIENT_OK;
+    if (running)
+        return WSCLIENT_NOT_CONNECTED;
+
+    //  The thread has given up already, it only has to finish
+    io_thread.join();
+    return WSCLIENT_ERROR;
+}
+
+int wsclient_send(const char* recipient, const char* content, size_t size) {
+    if (!running || !recipient || (!content && size))
+        return WSCLIENT_ERROR;
+
+    //  Without a connection, the message waits in the outbox if there is one
+    if (!is_connected() && !outbox_limit)
+        return WSCLIENT_NOT_CONNECTED;
+
+    send(std::string(recipient) + "::" + ws_id + "::0::::" + std::string(content, size));
+    return WSCLIENT_OK;
+}
+
+int wsclient_request(const char* recipient, const char* content, size_t size, int timeout_ms, char** reply,
+    size_t* reply_size) {
+
+    if (!running || !recipient || (!content && size) || !reply || !reply_size)
+        return WSCLIENT_ERROR;
+    if (!is_connected())
+        return WSCLIENT_NOT_CONNECTED;
+
+    auto request = std::make_shared<Request>();
+    request->recipient = recipient;
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex);
+        requests.push_back(request);
+    }
+
+    send(std::string(recipient) + "::" + ws_id + "::1::::" + std::string(content, size));
+
+    std::unique_lock<std::mutex> lock(requests_mutex);
+    if (!requests_done.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&request]() { return request->done; })) {
+        for (auto it = requests.begin(); it != requests.end(); ++it) {
+            if (*it == request) {
+                requests.erase(it);
+                break;
+            }
+        }
+        return WSCLIENT_TIMEOUT;
+    }
+
+    if (request->failed)
+        return WSCLIENT_NOT_DELIVERED;
+
+    *reply = static_cast<char*>(std::malloc(request->reply.size() + 1));
+    if (!*reply)
+        return WSCLIENT_ERROR;
+    std::memcpy(*reply, request->reply.c_str(), request->reply.size() + 1);
+    *reply_size = request->reply.size();
+    return WSCLIENT_OK;
+}
+
+void wsclient_free(char* reply) {
+    std::free(reply);
+}
+
+int wsclient_connected(void) {
+    return is_connected() ? 1 : 0;
+}
+
+void wsclient_disconnect(void) {
+    if (!io_thread.joinable())
+        return;
+
+    asio::post(get_io_service(), []() {
+        close_websocket();
+    });
+    io_thread.join();
+}
@@ -0,0 +1,92 @@
+/*  wsclient.h
+ *
+ *  Embeddable Websocket client: the connection, reconnection and command handling of the wsclient program, linked
+ *  into an application instead of reached through FIFO pipes. Build it with "bash build.sh <platform> lib", then link
+ *  bin/libwsclient_<platform>.a (or .so) with -pthread. C++ programs can use the wrapper in wsclient.hpp.
+ *
+ *      wsclient_options options = WSCLIENT_OPTIONS_INIT;
+ *      options.host = "192.168.0.10";
+ *      options.id = "camera";
+ *
+ *      if (wsclient_connect(&options, on_message, NULL) == WSCLIENT_OK) {
+ *          wsclient_send("dashboard", "temperature::21.5", 17);
+ *
+ *          char* reply;
+ *          size_t reply_size;
+ *          if (wsclient_request("clock", "time", 4, 1000, &reply, &reply_size) == WSCLIENT_OK)
+ *              wsclient_free(reply);
+ *
+ *      }
+ *      wsclient_disconnect();
+ *
+ *  There is one connection per process, and wsclient_connect() can only succeed once. All functions may be called
+ *  from any thread. Unless wsclient_connect() returned WSCLIENT_ERROR, the client's thread keeps running until
+ *  wsclient_disconnect(), which must be called before the program exits.
+ */
+
+#ifndef WSCLIENT_H
+#define WSCLIENT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  Results */
+#define WSCLIENT_OK              0
+#define WSCLIENT_ERROR          -1      /* Invalid arguments, or wsclient_connect() wasn't called */
+#define WSCLIENT_NOT_CONNECTED  -2      /* The connection is down and being retried */
+#define WSCLIENT_TIMEOUT        -3      /* No reply in time */
+#define WSCLIENT_NOT_DELIVERED  -4      /* The router says the recipient is not connected */
+
+/*  Connection settings. New fields are only ever added at the end, and "size" tells the library which ones the
+ *  application knows about, so programs built against an older header keep working. */
+typedef struct wsclient_options {
+    size_t size;                        /* sizeof(wsclient_options), set by WSCLIENT_OPTIONS_INIT */
+    const char* host;                   /* Router address, default "localhost" */
+    const char* port;                   /* Router port, default "8080" */
+    const char* id;                     /* Client ID */
+    int retries;                        /* Reconnection attempts, 0: forever */
+    int retry_interval;                 /* Milliseconds; reconnection attempts back off from this, doubling each time */
+    int handshake_timeout;              /* Milliseconds; wsclient_connect() waits this long for the first connection */
+    int log;                            /* Nonzero: log like the wsclient program with --log */
+    int commands;                       /* Nonzero: answer the built-in client commands (ping, stats, date, shutdown)
+                                           like the wsclient program, instead of passing them to the callback */
+    int retry_max;                      /* Longest wait between reconnection attempts, milliseconds */
+} wsclient_options;
+
+#define WSCLIENT_OPTIONS_INIT { sizeof(wsclient_options), "localhost", "8080", "", 10, 1000, 2000, 0, 0, 30000 }
+
+/*  Incoming message. Called on the client's thread, so it must return quickly. "content" is NUL terminated and only
+ *  valid during the call. For a publication to a subscribed topic, "sender" is "@<topic>::<sender>". */
+typedef void (*wsclient_receive_fn)(const char* sender, const char* content, size_t size, void* user);
+
+/*  Connects to the router and keeps reconnecting. Returns WSCLIENT_OK once connected, WSCLIENT_NOT_CONNECTED if the
+ *  first connection didn't succeed within the handshake timeout (it keeps trying), or WSCLIENT_ERROR. After
+ *  WSCLIENT_ERROR nothing is left running; otherwise call wsclient_disconnect() before exiting. */
+int wsclient_connect(const wsclient_options* options, wsclient_receive_fn receive, void* user);
+
+/*  Sends "content" to another client. While the connection is down, the message waits in the outbox (1 MB) and goes
+ *  out after reconnecting. */
+int wsclient_send(const char* recipient, const char* content, size_t size);
+
+/*  Sends "content" to another client and waits for its next message, the reply. Replies from the same client are
+ *  matched to requests in order. On success, "*reply" is NUL terminated and must be released with wsclient_free(). */
+int wsclient_request(const char* recipient, const char* content, size_t size, int timeout_ms, char** reply,
+    size_t* reply_size);
+
+void wsclient_free(char* reply);
+
+/*  Nonzero while the connection is up */
+int wsclient_connected(void);
+
+/*  Closes the connection and stops the client's thread. Must be called before the program exits, or the thread
+ *  is still running when its static objects are destroyed. Does nothing if there's no thread. */
+void wsclient_disconnect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
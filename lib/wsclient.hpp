@@ -0,0 +1,71 @@
+//  wsclient.hpp
+//  Thin C++ wrapper around the C interface of the embeddable client, see wsclient.h
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+
+#include "wsclient.h"
+
+namespace ws {
+
+class Client {
+public:
+    typedef std::function<void(const std::string& sender, const std::string& content)> Handler;
+
+    Client() : options_(WSCLIENT_OPTIONS_INIT) {}
+    ~Client() { disconnect(); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    //  Settings, before connect()
+    wsclient_options& options() { return options_; }
+
+    //  WSCLIENT_OK, or WSCLIENT_NOT_CONNECTED while the first connection is still being retried
+    int connect(const std::string& host, const std::string& port, const std::string& id, Handler handler) {
+        host_ = host;
+        port_ = port;
+        id_ = id;
+        handler_ = std::move(handler);
+
+        options_.host = host_.c_str();
+        options_.port = port_.c_str();
+        options_.id = id_.c_str();
+        return wsclient_connect(&options_, &Client::receive, this);
+    }
+
+    bool send(const std::string& recipient, const std::string& content) {
+        return wsclient_send(recipient.c_str(), content.data(), content.size()) == WSCLIENT_OK;
+    }
+
+    //  The reply, or nothing on timeout or if the recipient isn't connected
+    std::optional<std::string> request(const std::string& recipient, const std::string& content, int timeout_ms) {
+        char* reply;
+        size_t size;
+        if (wsclient_request(recipient.c_str(), content.data(), content.size(), timeout_ms, &reply, &size) != WSCLIENT_OK)
+            return std::nullopt;
+
+        std::string result(reply, size);
+        wsclient_free(reply);
+        return result;
+    }
+
+    bool connected() const { return wsclient_connected() != 0; }
+
+    void disconnect() { wsclient_disconnect(); }
+
+private:
+    static void receive(const char* sender, const char* content, size_t size, void* user) {
+        auto self = static_cast<Client*>(user);
+        if (self->handler_)
+            self->handler_(sender, std::string(content, size));
+    }
+
+    wsclient_options options_;
+    std::string host_, port_, id_;
+    Handler handler_;
+};
+
+}
@@ -1,9 +1,13 @@
 //  asio_ws.cpp
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <signal.h>
+#include <algorithm>
 #include <functional>
+#include <thread>
+#include <vector>
 
 #define ASIO_STANDALONE
 #include <asio.hpp>
@@ -13,20 +17,25 @@
 #include "constants.hpp"
 #include "commands.hpp"
 #include "asio_ws.hpp"
+#include "topics.hpp"
+#include "../core/deflate.hpp"
+#include "../core/timer_wheel.hpp"
+#include "../core/transport.hpp"
 #include "../core/utils.hpp"
 
 //  Internal variables
 websocketpp::connection_hdl hdl;
-websocketpp::server<websocketpp::config::asio> wsrouter;
+
+//  Sessions unlink themselves from the wheel when their connection goes, so it must outlive the router
+static TimerWheel liveness;
+server wsrouter;
+bool websocket_locking = true;
 static websocketpp::lib::error_code ec;
 asio::io_context io;
 
 //  Flag to indicate that the program is quitting
 static std::atomic<bool> quitting{false};
 
-std::vector<Client> unconfirmed_clients;
-std::unordered_map<std::string, Client> clients{};
-
 //  ---------------------------------------------------------------------------------------------------------------------
 
 asio::io_context& get_io_service() {
@@ -41,17 +50,17 @@ void close_websocket() {
 
     wsrouter.stop_listening();
 
-    for (const auto& client : unconfirmed_clients) {
+    for (const auto& client : registry.unconfirmed()) {
         websocketpp::lib::error_code ec;
         wsrouter.close(client.hdl, websocketpp::close::status::going_away, "Server shutting down", ec);
         if (ec) log("ERROR", "Failed to disconnect unconfirmed client: " + ec.message());
     }
 
-    for (const auto& [id, client] : clients) {
+    for (const auto& client : registry.confirmed()) {
         websocketpp::lib::error_code ec;
-        log("LOG", "Disconnecting client: " + id);
+        log("LOG", "Disconnecting client: " + client.id);
         wsrouter.close(client.hdl, websocketpp::close::status::going_away, "Server shutting down", ec);
-        if (ec) log("ERROR", "Failed to disconnect client " + id + ": " + ec.message());
+        if (ec) log("ERROR", "Failed to disconnect client " + client.id + ": " + ec.message());
     }
 
     wsrouter.stop_perpetual();
@@ -68,56 +77,354 @@ void close_websocket() {
 }
 
 int get_client_count() {
-    return static_cast<int>(unconfirmed_clients.size() + clients.size());
+    return static_cast<int>(registry.size());
+}
+
+//  Returns the connection (and with it, the session) of a handle, or nullptr if it's gone
+server::connection_ptr get_connection(websocketpp::connection_hdl hdl) {
+    websocketpp::lib::error_code ec;
+    server::connection_ptr con = wsrouter.get_con_from_hdl(hdl, ec);
+    return ec ? nullptr : con;
 }
 
-//  Removes a client
+//  Removes a client. Only the connection of "hdl" is removed, never a newer one that took over the ID since.
 void disconnect_client(const std::string& id, websocketpp::connection_hdl hdl) {
-    if (clients.erase(id)) {
-        wsrouter.close(hdl, websocketpp::close::status::normal, "Disconnected by router");
-        return;
+    auto con = get_connection(hdl);
+    if (con && registry.remove(*con)) {
+        websocketpp::lib::error_code ec;
+        wsrouter.close(hdl, websocketpp::close::status::normal, "Disconnected by router", ec);
+        if (ec) log("ERROR", "Failed to disconnect client " + id + ": " + ec.message());
     }
-    for (auto& uc : unconfirmed_clients) {
-        if (!uc.hdl.expired() && uc.hdl.lock() == hdl.lock()) {
-            uc = Client();
-            wsrouter.close(hdl, websocketpp::close::status::normal, "Disconnected by router");
+}
+
+//  Outbound queue ------------------------------------------------------------------------------------------------------
+//  Messages are handed to Websocket++ while it buffers less than the watermark for a client. Beyond that they wait in
+//  the client's own bounded queue, which is drained by a timer, so a slow client can only ever hold up itself.
+
+static const long drain_interval = 5;   //  Milliseconds
+
+static void schedule_drain(websocketpp::connection_hdl hdl);
+
+//  Hands a message to Websocket++. Call with the queue mutex held, to keep the order of messages.
+//  Prepared frames are written as they are. Frames to compress are handed over as payload instead, since
+//  compression state belongs to each connection.
+static bool send_now(const server::connection_ptr& con, const server::message_ptr& msg) {
+    websocketpp::lib::error_code ec;
+    if (con->deflate && msg->get_payload().size() >= deflate_threshold)
+        ec = con->send(msg->get_payload(), msg->get_opcode());
+    else
+        ec = con->send(msg);
+
+    if (ec) {
+        log("ERROR", "Websocket send failed: " + ec.message());
+        return false;
+    }
+    ++con->sent;
+    return true;
+}
+
+//  Sends queued messages while there is room below the watermark. Call with the queue mutex held.
+static void flush_queue(const server::connection_ptr& con) {
+    Session& session = *con;
+    while (!session.queue.empty() && con->get_buffered_amount() < send_watermark) {
+        server::message_ptr msg = std::move(session.queue.front());
+        session.queue.pop_front();
+        session.queued_bytes -= msg->get_payload().size();
+        send_now(con, msg);
+    }
+}
+
+static void schedule_drain(websocketpp::connection_hdl hdl) {
+    wsrouter.set_timer(drain_interval, [hdl](const websocketpp::lib::error_code& ec) {
+        auto con = get_connection(hdl);
+        if (ec || !con)
             return;
+
+        Session& session = *con;
+        std::lock_guard<std::mutex> lock(session.queue_mutex);
+        flush_queue(con);
+
+        if (!session.queue.empty()) {
+            schedule_drain(hdl);
+            return;
+        }
+
+        session.drain_scheduled = false;
+        if (session.overflowing) {
+            session.overflowing = false;
+            log("LOG", "Client \"" + session.id + "\" caught up. Messages dropped so far: " + std::to_string(session.dropped));
+        }
+    });
+}
+
+//  Sends a message to a client, or queues it if the client can't keep up. Returns false if the message was dropped.
+static bool queue_message(const server::connection_ptr& con, const server::message_ptr& msg) {
+    Session& session = *con;
+    std::unique_lock<std::mutex> lock(session.queue_mutex);
+
+    if (session.queue.empty() && con->get_buffered_amount() < send_watermark)
+        return send_now(con, msg);
+
+    const size_t size = msg->get_payload().size();
+
+    //  Queue is full: apply the overflow policy
+    if (session.queued_bytes + size > send_queue_limit) {
+        if (!session.overflowing) {
+            session.overflowing = true;
+            log("ERROR", "Client \"" + session.id + "\" can't keep up, its outbound queue is full");
+        }
+
+        if (send_overflow == Overflow::disconnect) {
+            ++session.dropped;
+            lock.unlock();
+
+            websocketpp::lib::error_code ec;
+            con->close(websocketpp::close::status::policy_violation, "Client too slow", ec);
+            return false;
+        }
+
+        if (send_overflow == Overflow::drop_oldest) {
+            while (!session.queue.empty() && session.queued_bytes + size > send_queue_limit) {
+                session.queued_bytes -= session.queue.front()->get_payload().size();
+                session.queue.pop_front();
+                ++session.dropped;
+            }
+        }
+
+        if (session.queued_bytes + size > send_queue_limit) {
+            ++session.dropped;
+            return false;
         }
     }
+
+    session.queue.push_back(msg);
+    session.queued_bytes += size;
+
+    if (!session.drain_scheduled) {
+        session.drain_scheduled = true;
+        schedule_drain(con->get_handle());
+    }
+    return true;
+}
+
+//  Builds a complete, unmasked frame. Server frames aren't masked, so a prepared message is identical for every
+//  recipient, and Websocket++ writes it as it is, without copying or reframing.
+//  The message comes from the pool, and the data is copied into the buffer it kept.
+static server::message_ptr prepare_frame(std::string_view data, websocketpp::frame::opcode::value opcode) {
+    auto msg = router_config::con_msg_manager_type::make(opcode, data.size());
+
+    websocketpp::frame::basic_header header(opcode, data.size(), true, false);
+    websocketpp::frame::extended_header extended(data.size());
+    msg->set_header(websocketpp::frame::prepare_header(header, extended));
+    msg->get_raw_payload().assign(data.data(), data.size());
+    msg->set_prepared(true);
+    return msg;
+}
+
+//  Turns a received message into the frame its recipients get, in the same buffer. Websocket++ is done with a message
+//  once its handler has returned, so the buffer it read the message into is handed on to the recipients, without a new
+//  allocation. It isn't free of copies, though: the first "offset" bytes, the recipient field, are cut off with
+//  erase(), which moves the rest of the payload down in one memmove per forwarded message, as many bytes as the
+//  payload has. Websocket++ writes a payload from its first byte and insists on a std::string, so there is no way to
+//  send it from an offset, and the header can't take the place of the prefix either, as frame lengths must use the
+//  shortest encoding. Text stays text and binary stays binary.
+static const server::message_ptr& reframe(const server::message_ptr& msg, size_t offset) {
+    const websocketpp::frame::opcode::value opcode = msg->get_opcode();
+    std::string& payload = msg->get_raw_payload();
+    payload.erase(0, offset);
+
+    websocketpp::frame::basic_header header(opcode, payload.size(), true, false);
+    websocketpp::frame::extended_header extended(payload.size());
+    msg->set_header(websocketpp::frame::prepare_header(header, extended));
+    msg->set_compressed(false);
+    msg->set_fin(true);
+    msg->set_prepared(true);
+    return msg;
+}
+
+//  Logs a message. Binary payloads are only logged by their size.
+void log_message(const std::string& type, const server::message_ptr& msg, const std::string& note) {
+    if (!logging_enabled)
+        return;
+
+    if (msg->get_opcode() == websocketpp::frame::opcode::binary)
+        log(type, "<" + std::to_string(msg->get_payload().size()) + " bytes binary>" + note);
+    else if (note.empty())
+        log(type, msg->get_payload());
+    else
+        log(type, msg->get_payload() + note);
+}
+
+static void send_frame(websocketpp::connection_hdl hdl, const server::message_ptr& msg) {
+    auto con = get_connection(hdl);
+    if (!con)
+        return;
+
+    if (queue_message(con, msg))
+        log_message("SENT", msg);
+}
+
+//  The very same buffer is queued on every connection
+static void broadcast_frame(const std::vector<websocketpp::connection_hdl>& recipients, const server::message_ptr& msg) {
+    size_t delivered = 0;
+    for (const auto& hdl : recipients) {
+        auto con = get_connection(hdl);
+        if (con && queue_message(con, msg))
+            ++delivered;
+    }
+
+    if (logging_enabled)
+        log_message("SENT", msg, " (" + std::to_string(delivered) + " clients)");
 }
 
 //  Send Websocket message (thread safe) --------------------------------------------------------------------------------
-void send_message(websocketpp::connection_hdl hdl, const std::string& data) {
-    asio::post(wsrouter.get_io_service(), [hdl, data]() {
-        websocketpp::lib::error_code ec;
-        wsrouter.send(hdl, data, websocketpp::frame::opcode::text, ec);
-        if (ec)
-            log("ERROR", "Websocket send failed: " + ec.message());
-        else
-            log("SENT", data);
+void send_message(websocketpp::connection_hdl hdl, std::string_view data, websocketpp::frame::opcode::value opcode) {
+    send_frame(hdl, prepare_frame(data, opcode));
+}
 
-    });
+//  Send the same Websocket message to many clients (thread safe) -----------------------------------------------------
+//  The frame is built once and shared by every connection.
+void broadcast_message(std::vector<websocketpp::connection_hdl> recipients, std::string_view data) {
+    if (recipients.empty())
+        return;
+
+    broadcast_frame(recipients, prepare_frame(data, websocketpp::frame::opcode::text));
+}
+
+//  Forward a received message (thread safe) ---------------------------------------------------------------------------
+//  The message itself goes to the recipient, without the first "offset" bytes (see reframe()). It can't be used
+//  afterwards.
+void forward_message(websocketpp::connection_hdl hdl, const server::message_ptr& msg, size_t offset) {
+    send_frame(hdl, reframe(msg, offset));
+}
+
+void forward_broadcast(std::vector<websocketpp::connection_hdl> recipients, const server::message_ptr& msg, size_t offset) {
+    if (recipients.empty())
+        return;
+
+    broadcast_frame(recipients, reframe(msg, offset));
 }
 
 //  Send Websocket error message (thread safe) ---------------------------------------------------------------------------
 void send_error(websocketpp::connection_hdl hdl, const std::string& sender, const int code, const std::string& error) {
-    asio::post(wsrouter.get_io_service(), [hdl, sender, code, error]() {
+    auto con = get_connection(hdl);
+    if (!con)
+        return;
 
+    server::message_ptr msg = prepare_frame("router::" + std::to_string(code) + "::::" + error, websocketpp::frame::opcode::text);
+    if (queue_message(con, msg))
+        log("ERROR", error);
+}
+
+//  Outbound statistics of a client: <id>:<queued messages>:<queued bytes>:<dropped>:<sent>:<received>
+std::string get_client_stats(websocketpp::connection_hdl hdl) {
+    auto con = get_connection(hdl);
+    if (!con)
+        return "";
+
+    Session& session = *con;
+    std::lock_guard<std::mutex> lock(session.queue_mutex);
+    return session.id + ":" + std::to_string(session.queue.size()) + ":" + std::to_string(session.queued_bytes) + ":" +
+        std::to_string(session.dropped) + ":" + std::to_string(session.sent) + ":" + std::to_string(session.received);
+}
+
+//  Liveness ------------------------------------------------------------------------------------------------------------
+//  Every connection has an entry in one timer wheel, which ticks every 100 ms. A new connection is due at its hello
+//  deadline, and is dropped if it's still unconfirmed by then. After that (or at once, without a deadline) it's due
+//  every ping interval: a client that left ping_misses pings in a row unanswered is disconnected, the others get the
+//  next ping. This way dead peers, e.g. half-open TCP connections, give their slot back without waiting for the kernel.
+//  A tick only touches the connections that are due, however many there are.
+
+static const long liveness_tick = 100;  //  Milliseconds
+static asio::steady_timer liveness_timer(io);
+
+enum class Due { evict, dead, ping };
+
+struct LivenessAction {
+    websocketpp::connection_hdl hdl;
+    Due due;
+};
+
+static uint64_t liveness_ticks(int seconds) {
+    return static_cast<uint64_t>(seconds) * 1000 / liveness_tick;
+}
+
+//  A new connection, just registered as unconfirmed
+static void watch_connection(websocketpp::connection_hdl hdl, Session& session) {
+    session.hdl = hdl;
+    if (hello_timeout)
+        liveness.schedule(session, liveness_ticks(hello_timeout));
+    else if (ping_interval)
+        liveness.schedule(session, liveness_ticks(ping_interval));
+}
+
+static void check_liveness() {
+
+    //  Decide with the wheel locked, act without it: closing a connection may destroy its session
+    static std::vector<LivenessAction> actions;
+    actions.clear();
+
+    liveness.advance([](TimerWheel::Entry& entry) -> uint64_t {
+        Session& session = static_cast<Session&>(entry);
+        if (!session.confirmed && hello_timeout) {
+            actions.push_back({ session.hdl, Due::evict });
+            return 0;
+        }
+        if (!ping_interval)
+            return 0;
+        if (session.unanswered_pings >= ping_misses) {
+            actions.push_back({ session.hdl, Due::dead });
+            return 0;
+        }
+        actions.push_back({ session.hdl, Due::ping });
+        return liveness_ticks(ping_interval);
+    });
+
+    for (const auto& action : actions) {
+        auto con = get_connection(action.hdl);
+        if (!con)
+            continue;
+
+        Session& session = *con;
         websocketpp::lib::error_code ec;
-        std::string message = "router::" + std::to_string(code) + "::::" + error;
-        wsrouter.send(hdl, message, websocketpp::frame::opcode::text, ec);
-        if (ec)
-            log("ERROR", "Websocket send failed: " + ec.message());
-        else
-            log("ERROR", error);
-        
+
+        switch (action.due) {
+        case Due::evict:
+            //  It may have said hello since
+            if (!registry.erase_unconfirmed(session)) {
+                if (session.confirmed && ping_interval)
+                    liveness.schedule(session, liveness_ticks(ping_interval));
+                break;
+            }
+            log("ERROR", "Unconfirmed client didn't say hello within " + std::to_string(hello_timeout) + " seconds, disconnecting");
+            con->close(websocketpp::close::status::policy_violation, "No hello", ec);
+            break;
+
+        case Due::dead:
+            if (!registry.remove(session))
+                break;
+            log("ERROR", "Client \"" + session.id + "\" didn't answer " + std::to_string(ping_misses) + " ping(s), disconnecting");
+            con->close(websocketpp::close::status::going_away, "Ping timeout", ec);
+            break;
+
+        case Due::ping:
+            ++session.unanswered_pings;
+            con->ping("", ec);
+            break;
+        }
+    }
+
+    liveness_timer.expires_at(liveness_timer.expiry() + std::chrono::milliseconds(liveness_tick));
+    liveness_timer.async_wait([](const asio::error_code& ec) {
+        if (!ec)
+            check_liveness();
     });
 }
 
 //  Start Websocket service ---------------------------------------------------------------------------------------------
 //  The event handler function to process incoming messages is passed as argument
 
-bool init_websocket(std::function<void(websocketpp::connection_hdl, std::string)> on_message) {
+bool init_websocket(std::function<void(websocketpp::connection_hdl, const server::message_ptr&)> on_message) {
 
     log("LOG", "Opening Websocket router at port " + std::to_string(port) + "...");
     
@@ -125,50 +432,63 @@ bool init_websocket(std::function<void(websocketpp::connection_hdl, std::string)
     wsrouter.clear_access_channels(websocketpp::log::alevel::all);
     wsrouter.clear_error_channels(websocketpp::log::elevel::all);
     
+    //  Websocket++ only needs its locks with more than one io thread (see config.hpp)
+    websocket_locking = threads > 1;
+
     wsrouter.init_asio(&io);
     wsrouter.start_perpetual();
+    registry.reserve(static_cast<size_t>(maxConnections));
+
+    //  Socket options of every accepted connection, before its handshake
+    wsrouter.set_tcp_post_init_handler([](websocketpp::connection_hdl hdl) {
+        auto con = get_connection(hdl);
+        if (con)
+            tune_socket(con->get_raw_socket());
+    });
 
 	//	Connection handler      
     wsrouter.set_open_handler([&](websocketpp::connection_hdl hdl) {
-        const int conns = unconfirmed_clients.size() + clients.size();
+        auto con = wsrouter.get_con_from_hdl(hdl);
+        con->deflate = deflate_enabled && con->get_response_header("Sec-WebSocket-Extensions").find("permessage-deflate") != std::string::npos;
+
+        const int conns = registry.add_unconfirmed(hdl, *con, maxConnections);
 
-        if (conns >= maxConnections) {
+        if (conns < 0) {
             wsrouter.close(hdl, websocketpp::close::status::normal, "Router full");
             log("ERROR", "Connection rejected: Router is full");
             return;
         }
         
-        unconfirmed_clients.emplace_back(hdl);
-        log("LOG", "New client connected. Current count: " + std::to_string(conns + 1));
+        watch_connection(hdl, *con);
+        log("LOG", "New client connected. Current count: " + std::to_string(conns));
+    });
+
+    //  Any pong answers every ping sent so far
+    wsrouter.set_pong_handler([](websocketpp::connection_hdl hdl, std::string) {
+        auto con = get_connection(hdl);
+        if (con)
+            con->unanswered_pings = 0;
     });
     
     //  Connection close event handler
     wsrouter.set_close_handler([&](websocketpp::connection_hdl hdl) {
-        const int conns = unconfirmed_clients.size() + clients.size();
-
-        // Remove from unconfirmed_clients
-        for (auto it = unconfirmed_clients.begin(); it != unconfirmed_clients.end(); ++it) {
-            if (!it->hdl.expired() && it->hdl.lock() == hdl.lock()) {
-                unconfirmed_clients.erase(it);
-                log("LOG", "Unconfirmed client disconnected. Current count: " + std::to_string(conns - 1));
-                return;
-            }
-        }
+        auto con = wsrouter.get_con_from_hdl(hdl);
+        Session& session = *con;
+        topics.remove(session);
+        if (!registry.remove(session))
+            return;
 
-        // Remove from confirmed clients
-        for (auto it = clients.begin(); it != clients.end();) {
-            if (!it->second.hdl.expired() && it->second.hdl.lock() == hdl.lock()) {
-                log("LOG", "Client \"" + it->second.id + "\" disconnected. Current count: " + std::to_string(conns - 1));
-                it = clients.erase(it);
-            }
-            else
-                ++it;
-        }
+        const std::string count = std::to_string(registry.size());
+        if (!session.confirmed)
+            log("LOG", "Unconfirmed client disconnected. Current count: " + count);
+        else
+            log("LOG", "Client \"" + session.id + "\" disconnected (received " + std::to_string(session.received) +
+                ", sent " + std::to_string(session.sent) + "). Current count: " + count);
     });
 
     //  Message event handler
-    wsrouter.set_message_handler([on_message](websocketpp::connection_hdl hdl, websocketpp::server<websocketpp::config::asio>::message_ptr msg) {
-        process_commands(hdl, msg->get_payload());
+    wsrouter.set_message_handler([on_message](websocketpp::connection_hdl hdl, server::message_ptr msg) {
+        on_message(hdl, msg);
     });
 
 
@@ -177,10 +497,39 @@ bool init_websocket(std::function<void(websocketpp::connection_hdl, std::string)
     //  Initialize server
     try {
         wsrouter.set_reuse_addr(true);
+
+        //  Room for a reconnection storm of every client; the kernel caps it at net.core.somaxconn
+        wsrouter.set_listen_backlog(std::max(maxConnections, 128));
         wsrouter.listen(port);
         wsrouter.start_accept();
-        log("LOG", "Websocket router initialized");
+
+        if (hello_timeout || ping_interval) {
+            liveness_timer.expires_after(std::chrono::milliseconds(liveness_tick));
+            liveness_timer.async_wait([](const asio::error_code& ec) {
+                if (!ec)
+                    check_liveness();
+            });
+        }
+
+        log("LOG", "Websocket router initialized with " + std::to_string(threads) + " thread(s)");
+
+        //  Extra io threads. Websocket++ wraps the handlers of every connection in its own strand,
+        //  so messages of a single client are still processed in order.
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads; ++i) {
+            pool.emplace_back([]() {
+                try {
+                    wsrouter.run();
+                } catch (const std::exception& e) {
+                    log("ERROR", std::string("Websocket io thread terminated: ") + e.what());
+                }
+            });
+        }
+
         wsrouter.run();
+
+        for (auto& t : pool)
+            t.join();
     } catch (const std::exception& e) {
         log("ERROR", std::string("Failed to start WebSocket server on port " + std::to_string(port) + ": ") + e.what());
         return false;
@@ -2,26 +2,27 @@
 #pragma once
 
 #include <functional>
+#include <string_view>
 #include <asio/steady_timer.hpp>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 
-bool init_websocket(std::function<void(websocketpp::connection_hdl, std::string)> on_message);
+#include "config.hpp"
+#include "registry.hpp"
+
+bool init_websocket(std::function<void(websocketpp::connection_hdl, const server::message_ptr&)> on_message);
 void close_websocket();
-void send_message(websocketpp::connection_hdl hdl, const std::string& data);
+void send_message(websocketpp::connection_hdl hdl, std::string_view data,
+    websocketpp::frame::opcode::value opcode = websocketpp::frame::opcode::text);
+void broadcast_message(std::vector<websocketpp::connection_hdl> recipients, std::string_view data);
+void forward_message(websocketpp::connection_hdl hdl, const server::message_ptr& msg, size_t offset);
+void forward_broadcast(std::vector<websocketpp::connection_hdl> recipients, const server::message_ptr& msg, size_t offset);
 void send_error(websocketpp::connection_hdl hdl, const std::string& sender, const int code, const std::string& error);
+std::string get_client_stats(websocketpp::connection_hdl hdl);
+void log_message(const std::string& type, const server::message_ptr& msg, const std::string& note = "");
 int get_client_count();
+server::connection_ptr get_connection(websocketpp::connection_hdl hdl);
 void disconnect_client(const std::string& id, websocketpp::connection_hdl hdl);
 
-//  Unconfirmed and confirmed Websocket clients
-struct Client {
-    websocketpp::connection_hdl hdl;
-    std::string id;
-    Client(websocketpp::connection_hdl h = websocketpp::connection_hdl(), const std::string& i = "")
-        : hdl(h), id(i) {}
-};
-
-extern std::vector<Client> unconfirmed_clients;
-extern std::unordered_map<std::string, Client> clients;
 extern websocketpp::connection_hdl hdl;
-extern websocketpp::server<websocketpp::config::asio> wsrouter;
\ No newline at end of file
+extern server wsrouter;
\ No newline at end of file
@@ -14,6 +14,13 @@
 
 #include "./constants.hpp"
 #include "./asio_ws.hpp"
+#include "./mailbox.hpp"
+#include "./message.hpp"
+#include "./message_pool.hpp"
+#include "./topics.hpp"
+#include "../core/deflate.hpp"
+#include "../core/transport.hpp"
+#include "../core/logger.hpp"
 #include "../core/utils.hpp"
 
 //  Analyze command line ---------------------------------------------------------------------------------------------------------------
@@ -45,7 +52,7 @@ bool process_args(int argc, char* argv[]) {
 
       	//  Maximum number of connections
       	if (i > 0 && (std::strcmp(argv[i-1], "--connections") == 0 || std::strcmp(argv[i-1], "-c") == 0) && argv[i] && *argv[i]) { 
-      	  auto value = string_to_int(argv[i], 1, 64);
+      	  auto value = string_to_int(argv[i], 1, 100000);
       	  if (!value || !value.value()) {
       	    std::cout << "Invalid --connections value" << std::endl;
       	    return false;
@@ -54,6 +61,118 @@ bool process_args(int argc, char* argv[]) {
       	  maxConnections = value.value();
       	}		
 
+      	//  Number of io threads
+      	if (i > 0 && (std::strcmp(argv[i-1], "--threads") == 0 || std::strcmp(argv[i-1], "-t") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 1, 256);
+      	  if (!value) {
+      	    std::cout << "Invalid --threads value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  threads = value.value();
+      	}		
+
+      	//  Outbound queue watermark
+      	if (i > 0 && (std::strcmp(argv[i-1], "--watermark") == 0 || std::strcmp(argv[i-1], "-w") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 1, 1048576);
+      	  if (!value) {
+      	    std::cout << "Invalid --watermark value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  send_watermark = static_cast<size_t>(value.value()) * 1024;
+      	}		
+
+      	//  Outbound queue limit
+      	if (i > 0 && (std::strcmp(argv[i-1], "--queue_limit") == 0 || std::strcmp(argv[i-1], "-q") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 1, 1048576);
+      	  if (!value) {
+      	    std::cout << "Invalid --queue_limit value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  send_queue_limit = static_cast<size_t>(value.value()) * 1024;
+      	}		
+
+      	//  Outbound queue overflow policy
+      	if (i > 0 && (std::strcmp(argv[i-1], "--overflow") == 0 || std::strcmp(argv[i-1], "-o") == 0) && argv[i] && *argv[i]) { 
+      	  if (std::strcmp(argv[i], "drop_oldest") == 0)
+      	    send_overflow = Overflow::drop_oldest;
+      	  else if (std::strcmp(argv[i], "drop_newest") == 0)
+      	    send_overflow = Overflow::drop_newest;
+      	  else if (std::strcmp(argv[i], "disconnect") == 0)
+      	    send_overflow = Overflow::disconnect;
+      	  else {
+      	    std::cout << "Invalid --overflow value" << std::endl;
+      	    return false;
+      	  }
+      	}		
+
+      	//  Liveness
+      	if (i > 0 && (std::strcmp(argv[i-1], "--ping") == 0 || std::strcmp(argv[i-1], "-pi") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 86400);
+      	  if (!value) {
+      	    std::cout << "Invalid --ping value" << std::endl;
+      	    return false;
+      	  }
+
+      	  ping_interval = value.value();
+      	}
+
+      	if (i > 0 && (std::strcmp(argv[i-1], "--ping_misses") == 0 || std::strcmp(argv[i-1], "-pm") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 1, 1000);
+      	  if (!value) {
+      	    std::cout << "Invalid --ping_misses value" << std::endl;
+      	    return false;
+      	  }
+
+      	  ping_misses = value.value();
+      	}
+
+      	if (i > 0 && (std::strcmp(argv[i-1], "--hello_timeout") == 0 || std::strcmp(argv[i-1], "-ht") == 0) && argv[i] && *argv[i]) {
+      	  auto value = string_to_int(argv[i], 0, 86400);
+      	  if (!value) {
+      	    std::cout << "Invalid --hello_timeout value" << std::endl;
+      	    return false;
+      	  }
+
+      	  hello_timeout = value.value();
+      	}
+
+      	//  Mailboxes of offline clients
+      	if (i > 0 && (std::strcmp(argv[i-1], "--mailbox") == 0 || std::strcmp(argv[i-1], "-m") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 0, 1000000);
+      	  if (!value) {
+      	    std::cout << "Invalid --mailbox value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  mailbox_messages = value.value();
+      	}		
+
+      	if (i > 0 && (std::strcmp(argv[i-1], "--mailbox_size") == 0 || std::strcmp(argv[i-1], "-ms") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 1, 1048576);
+      	  if (!value) {
+      	    std::cout << "Invalid --mailbox_size value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  mailbox_bytes = static_cast<size_t>(value.value()) * 1024;
+      	}		
+
+      	if (i > 0 && (std::strcmp(argv[i-1], "--mailbox_ttl") == 0 || std::strcmp(argv[i-1], "-mt") == 0) && argv[i] && *argv[i]) { 
+      	  auto value = string_to_int(argv[i], 1, 31536000);
+      	  if (!value) {
+      	    std::cout << "Invalid --mailbox_ttl value" << std::endl;
+      	    return false;
+      	  }
+          
+      	  mailbox_ttl = value.value();
+      	}		
+
+      	if (i > 0 && (std::strcmp(argv[i-1], "--mailbox_dir") == 0 || std::strcmp(argv[i-1], "-md") == 0) && argv[i] && *argv[i])
+      	  mailbox_dir = argv[i];
+
       	//	Websocket port
       	if (i > 0 && (std::strcmp(argv[i-1], "--port") == 0 || std::strcmp(argv[i-1], "-p") == 0) && argv[i] && *argv[i]) { 
           auto value = string_to_int(argv[i], 0, 65535);
@@ -67,7 +186,7 @@ bool process_args(int argc, char* argv[]) {
       	}
 	}
 
-  return true;
+  return process_log_args(argc, argv) && process_deflate_args(argc, argv) && process_transport_args(argc, argv);
 }
 
 //  Registers a client as confirmed upon receiving "hello" or other command with ID
@@ -84,35 +203,40 @@ void handle_hello(websocketpp::connection_hdl hdl, const std::string& id) {
       return;
   }
 
-  for (auto it = unconfirmed_clients.begin(); it != unconfirmed_clients.end(); ++it) {
-      if (!it->hdl.expired() && it->hdl.lock() == hdl.lock()) {
-          if (clients.count(id)) {
-              disconnect_client(id, clients[id].hdl);
-          }
-          clients[id] = std::move(*it);
-          unconfirmed_clients.erase(it);
-          return;
+  auto con = get_connection(hdl);
+  if (!con)
+      return;
+
+  //  With mailboxes, messages that waited for this client are sent as part of confirming it
+  websocketpp::connection_hdl replaced;
+  if (mailbox_messages > 0 ? mailboxes.confirm(hdl, *con, id, replaced) : registry.confirm(hdl, *con, id, replaced)) {
+      //  confirm() has already taken the previous holder of the ID out of the registry, so it is only closed
+      if (!replaced.expired()) {
+          websocketpp::lib::error_code ec;
+          wsrouter.close(replaced, websocketpp::close::status::normal, "Replaced by a new connection", ec);
+          if (ec) log("ERROR", "Failed to disconnect the previous client " + id + ": " + ec.message());
       }
+      return;
   }
 
   send_message(hdl, "router::0::::hello " + id);
 }
 
 //  Implementations of router commands
-void handle_command(websocketpp::connection_hdl hdl, const std::string& sender, const std::vector<std::string>& parts) {
+void handle_command(websocketpp::connection_hdl hdl, const std::string& sender, const MessageHeader& header) {
 
-  if (parts.size() < 3) {
+  if (header.fields < 3) {
       send_error(hdl, sender, 1, "Message could not be parsed");
       return;
   }
-  std::string command = parts[2];
+  std::string command(header.expects_reply);
 
   //  -------------------------------------------------------------------------------------------------------------------
   //  "hello"
   //  Identifies a new client
   //  -------------------------------------------------------------------------------------------------------------------
   if (command == "hello") {
-      if (parts.size() < 3) {
+      if (header.fields < 3) {
           send_error(hdl, sender, 2, "Message is incomplete");
           return;
       }
@@ -141,70 +265,120 @@ void handle_command(websocketpp::connection_hdl hdl, const std::string& sender,
   //  Gets list of connected clients
   //  -------------------------------------------------------------------------------------------------------------------
   if (command == "clients") {
-      if (parts.size() < 4) {
+      if (header.fields < 4) {
           send_error(hdl, sender, 2, "Message is incomplete");
           return;
       }
-      std::string target = parts[3];
+      std::string target(header.reply_to);
+      websocketpp::connection_hdl target_hdl;
 
       //  Get all clients
       if (target == "*") {
-          std::string list;
-          for (const auto& [id, _] : clients) {
-              if (!list.empty()) list += ",";
-              list += id;
-          }
+          std::string list = registry.list_ids();
           send_message(hdl, "router::0::::" + (list.empty() ? "None" : list));
       } else 
       
       //  Get number of confirmed and unconfirmed clients
       if (target == "") {
-          send_message(hdl, "router::0::::" + std::to_string(clients.size()) + "," + std::to_string(unconfirmed_clients.size()));
+          send_message(hdl, "router::0::::" + std::to_string(registry.confirmed_count()) + "," + std::to_string(registry.unconfirmed_count()));
       } else 
       
       //  Get if specific client is connected
-      if (clients.count(target)) {
+      if (registry.find(target, target_hdl)) {
           send_message(hdl, "router::0::::" + target);
       } else {
           send_error(hdl, sender, 3, "Client \"" + target + "\" is not connected to server");
       }
   } else
 
+  //  -------------------------------------------------------------------------------------------------------------------
+  //  "stats"
+  //  Outbound queue statistics of every confirmed client
+  //  -------------------------------------------------------------------------------------------------------------------
+  if (command == "stats") {
+      std::string list;
+      for (const auto& client : registry.confirmed()) {
+          std::string stats = get_client_stats(client.hdl);
+          if (stats.empty())
+              continue;
+          if (!list.empty()) list += ",";
+          list += stats;
+      }
+      send_message(hdl, "router::0::::" + (list.empty() ? "None" : list));
+  } else
+
+  //  -------------------------------------------------------------------------------------------------------------------
+  //  "mailboxes"
+  //  Number of mailboxes, messages waiting in them, and messages that expired
+  //  -------------------------------------------------------------------------------------------------------------------
+  if (command == "mailboxes") {
+      send_message(hdl, "router::0::::" + mailboxes.stats());
+  } else
+
+  //  -------------------------------------------------------------------------------------------------------------------
+  //  "pool"
+  //  Allocation counters of the message pool
+  //  -------------------------------------------------------------------------------------------------------------------
+  if (command == "pool") {
+      send_message(hdl, "router::0::::" + pool_stats());
+  } else
+
+  //  -------------------------------------------------------------------------------------------------------------------
+  //  "subscribe" / "unsubscribe"
+  //  Adds or removes a topic subscription of the sender
+  //  -------------------------------------------------------------------------------------------------------------------
+  if (command == "subscribe" || command == "unsubscribe") {
+      if (header.fields < 4) {
+          send_error(hdl, sender, 2, "Message is incomplete");
+          return;
+      }
+
+      std::string topic(header.reply_to);
+      if (!is_valid_topic(topic, true)) {
+          send_error(hdl, sender, 9, "Invalid topic: \"" + topic + "\"");
+          return;
+      }
+
+      auto con = get_connection(hdl);
+      if (!con)
+          return;
+
+      if (command == "subscribe") {
+          topics.subscribe(topic, *con, hdl);
+          send_message(hdl, "router::0::::subscribed " + topic);
+      } else if (topics.unsubscribe(topic, *con)) {
+          send_message(hdl, "router::0::::unsubscribed " + topic);
+      } else {
+          send_error(hdl, sender, 10, "Not subscribed to \"" + topic + "\"");
+      }
+  } else
+
   //  -------------------------------------------------------------------------------------------------------------------
   //  "disconnect"
   //  Forces the router to drop a connected client
   //  -------------------------------------------------------------------------------------------------------------------
   if (command == "disconnect") {
-      if (parts.size() < 4) {
+      if (header.fields < 4) {
           send_error(hdl, sender, 2, "Message is incomplete");
           return;
       }
       
-      std::string target = parts[3];
+      std::string target(header.reply_to);
+      websocketpp::connection_hdl target_hdl;
 
       if (target == "*" || target == "") {
 
-          if (target == "*") {
-              for (auto& [id, client] : clients) {
-                  if (!client.hdl.expired()) {
-                      wsrouter.close(client.hdl, websocketpp::close::status::normal, "Disconnected by router");
-                  }
+          for (auto& client : registry.take(target == "*")) {
+              if (!client.hdl.expired()) {
+                  websocketpp::lib::error_code ec;
+                  wsrouter.close(client.hdl, websocketpp::close::status::normal, "Disconnected by router", ec);
               }
-              clients.clear();
           }
 
-          for (auto& uc : unconfirmed_clients) {
-              if (!uc.hdl.expired()) {
-                  wsrouter.close(uc.hdl, websocketpp::close::status::normal, "Disconnected by router");
-              }
-              uc = Client();
-          }
-          unconfirmed_clients.clear();
-
       } else if (!is_valid_id(target)) {
           send_error(hdl, sender, 4, "Invalid recipient id: \"" + target + "\"");
-      } else if (clients.count(target)) {
-          disconnect_client(target, clients[target].hdl);
+      } else if (registry.find(target, target_hdl)) {
+          disconnect_client(target, target_hdl);
           send_message(hdl, "router::0::::Client " + target + " disconnected.");
       } else {
           send_error(hdl, sender, 3, "Client \"" + target + "\" is not connected to server");
@@ -220,32 +394,31 @@ void handle_command(websocketpp::connection_hdl hdl, const std::string& sender,
 }
 
 //	Commands processor -----------------------------------------------------------------------------------------------------------------
-void process_commands(websocketpp::connection_hdl hdl, std::string payload) {
+void process_commands(websocketpp::connection_hdl hdl, const message_type::ptr& msg) {
+  const std::string& payload = msg->get_payload();
+  const bool binary = msg->get_opcode() == websocketpp::frame::opcode::binary;
 
-  log("RECV", payload);
+  log_message("RECV", msg);
 
-  //  Get message parts
-  std::vector<std::string> parts = split(payload, "::");
+  auto con = get_connection(hdl);
+  if (!con)
+      return;
+  ++con->received;
 
-  if (parts.size() < 3) {
-    send_error(hdl, parts.size() > 1 ? parts[1] : "", 2, "Message is incomplete");
+  //  Get message header. The payload itself is left alone.
+  MessageHeader header = parse_header(payload);
+
+  if (header.fields < 3) {
+    send_error(hdl, std::string(header.sender), 2, "Message is incomplete");
     return;
   }
 
   //  Get message parts
-  std::string recipient = parts[0];
-  std::string sender_id = parts[1];
+  std::string recipient(header.recipient);
+  std::string sender_id(header.sender);
 
   //  Auto-register previously unconfirmed client
-  bool is_unconfirmed = true;
-  for (const auto& c : clients) {
-      if (c.second.hdl.lock() == hdl.lock()) {
-          is_unconfirmed = false;
-          break;
-      }
-  }
-
-  if (is_unconfirmed && !sender_id.empty())
+  if (!con->confirmed && !sender_id.empty())
       handle_hello(hdl, sender_id);
 
   // Validate client IDs retrieved from the message
@@ -254,56 +427,77 @@ void process_commands(websocketpp::connection_hdl hdl, std::string payload) {
       return;
   }
   
-  if (!is_valid_id(recipient)) {
-      send_error(hdl, sender_id, 5, "Invalid recipient id: \"" + sender_id + "\"");
+  //  "@<topic>" publishes to the subscribers of a topic
+  const bool publish = !recipient.empty() && recipient[0] == '@';
+
+  if (publish && !is_valid_topic(std::string_view(recipient).substr(1), false)) {
+      send_error(hdl, sender_id, 9, "Invalid topic: \"" + recipient.substr(1) + "\"");
       return;
   }
 
-  std::string expects_reply;
-  std::string reply_to;
-  std::string content;  
+  if (!publish && recipient != "*" && !is_valid_id(recipient)) {
+      send_error(hdl, sender_id, 5, "Invalid recipient id: \"" + recipient + "\"");
+      return;
+  }
 
   //  Handle router commands
   //  
-  if (recipient == "router" && sender_id != "router" && reply_to != "router") {
-    expects_reply = '1';
-    reply_to = parts[1];
-    content = join(parts, "::", 2);
-
-    handle_command(hdl, sender_id, parts);
+  if (recipient == "router" && sender_id != "router") {
+    handle_command(hdl, sender_id, header);
     return;
   }
 
-  expects_reply = parts[2];
-  reply_to = parts[3];
-  content = join(parts, "::", 4);  
+  if (header.fields < 4) {
+      send_error(hdl, sender_id, 2, "Message is incomplete");
+      return;
+  }
 
-  if (sender_id == "router" || reply_to == "router") {
+  if (sender_id == "router" || header.reply_to == "router") {
       send_error(hdl, sender_id, 6, "The router cannot be marked as sender, or be replied to.");
       return;
   }
 
   //  Forward message to recipient ---------------------------------------------------------------------------------
+  //  The recipient gets everything after "<recipient>::". The received message itself is passed on with the recipient
+  //  field cut off, so the payload and the header fields are gone after forwarding. Subscribers get publications whole,
+  //  "@<topic>::" included, as a wildcard subscription doesn't tell them which topic matched.
 
-  std::string truncated_msg = join(parts, "::", 1);
+  websocketpp::connection_hdl recipient_hdl;
+  const size_t offset = static_cast<size_t>(header.forward.data() - payload.data());
 
   //  Send to all clients
   if (recipient == "*") {
-      for (const auto& [id, client] : clients) {
-          if (!client.hdl.expired() && client.id != sender_id) {
-              send_message(client.hdl, truncated_msg);
-          }
-      }
+      forward_broadcast(registry.handles(sender_id), msg, offset);
+  } else 
+
+  //  Send to the subscribers of a topic. Nobody being subscribed is not an error.
+  if (publish) {
+      forward_broadcast(topics.match(std::string_view(recipient).substr(1), &*con), msg, 0);
   } else 
 
   //  Send to single client
-  if (clients.count(recipient)) {
-      if (!clients[recipient].hdl.expired()) {
-          send_message(clients[recipient].hdl, truncated_msg);
+  if (registry.find(recipient, recipient_hdl)) {
+      if (mailbox_messages > 0)
+          mailboxes.wait_delivery();
+      if (!recipient_hdl.expired()) {
+          forward_message(recipient_hdl, msg, offset);
       }
   } 
   
-  //  Client not found, send error
+  //  Client not found: keep the message for it if mailboxes are on, otherwise send error
+  else if (mailbox_messages > 0) {
+      switch (mailboxes.store(recipient, recipient_hdl, header.forward, binary)) {
+          case Mailboxes::Result::stored:
+              break;
+          case Mailboxes::Result::online:
+              if (!recipient_hdl.expired())
+                  forward_message(recipient_hdl, msg, offset);
+              break;
+          case Mailboxes::Result::full:
+              send_error(hdl, sender_id, 11, "Mailbox of \"" + recipient + "\" is full");
+              break;
+      }
+  }
   else {
       send_error(hdl, sender_id, 3, "Client \"" + recipient + "\" is not connected to server");
   }
@@ -1,8 +1,11 @@
 //  commands.hpp
 #pragma once
 
+#include "message.hpp"
+#include "session.hpp"
+
 bool process_args(int argc, char* argv[]);
-void process_commands(websocketpp::connection_hdl hdl, std::string payload);
+void process_commands(websocketpp::connection_hdl hdl, const message_type::ptr& msg);
 void handle_hello(websocketpp::connection_hdl hdl, const std::string& id);
-void handle_command(websocketpp::connection_hdl hdl, const std::string& sender, const std::vector<std::string>& parts);
+void handle_command(websocketpp::connection_hdl hdl, const std::string& sender, const MessageHeader& header);
 
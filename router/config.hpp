@@ -0,0 +1,67 @@
+//  config.hpp
+#pragma once
+
+#include <mutex>
+
+#define ASIO_STANDALONE
+#include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/server.hpp>
+
+#include "session.hpp"
+#include "../core/deflate.hpp"
+
+//  Locking inside Websocket++ ------------------------------------------------------------------------------------------
+//  Websocket++ guards the state and the write queue of every connection with mutexes. With a single io thread nothing
+//  runs concurrently, so the router turns them off at startup (see init_websocket). Never changed while connections
+//  exist.
+
+extern bool websocket_locking;
+
+class switchable_mutex {
+public:
+    void lock() {
+        if (websocket_locking)
+            mutex.lock();
+    }
+    void unlock() {
+        if (websocket_locking)
+            mutex.unlock();
+    }
+
+private:
+    std::mutex mutex;
+};
+
+struct switchable_concurrency {
+    typedef switchable_mutex mutex_type;
+    typedef std::lock_guard<switchable_mutex> scoped_lock_type;
+};
+
+//  Websocket++ configuration of the router
+struct router_config : public websocketpp::config::asio {
+    typedef router_config type;
+    typedef Session connection_base;
+    typedef ::message_type message_type;
+    typedef pooled_msg_manager<message_type> con_msg_manager_type;
+    typedef websocketpp::message_buffer::alloc::endpoint_msg_manager<con_msg_manager_type> endpoint_msg_manager_type;
+    typedef switchable_concurrency concurrency_type;
+
+    //  Part of every connection object. IoT messages are mostly short; longer ones just take a few more reads.
+    //  See "Connection budget" in the README. READ_BUFFER=<bytes> bash build.sh ... changes it.
+#ifdef READ_BUFFER
+    static const size_t connection_read_buffer_size = READ_BUFFER;
+#else
+    static const size_t connection_read_buffer_size = 4096;
+#endif
+
+    struct transport_config : public websocketpp::config::asio::transport_config {
+        typedef type::concurrency_type concurrency_type;
+    };
+    typedef websocketpp::transport::asio::endpoint<transport_config> transport_type;
+
+#ifdef DEFLATE
+    typedef compression::server_extension permessage_deflate_type;
+#endif
+};
+
+typedef websocketpp::server<router_config> server;
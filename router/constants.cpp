@@ -17,6 +17,25 @@ int port = 8080;
 //  Maximum number of connections
 int maxConnections = 8;
 
+//  Number of threads running the Websocket event loop
+int threads = 1;
+
+//  Outbound queue of each client
+size_t send_watermark = 256 * 1024;
+size_t send_queue_limit = 1024 * 1024;
+Overflow send_overflow = Overflow::drop_oldest;
+
+//  Liveness
+int ping_interval = 30;
+int ping_misses = 3;
+int hello_timeout = 10;
+
+//  Mailboxes of offline clients, off by default
+int mailbox_messages = 0;
+size_t mailbox_bytes = 256 * 1024;
+int mailbox_ttl = 300;
+std::string mailbox_dir = "";
+
 //  Websocket client ID - it's always "router"
 const std::string ws_id = "router";
 
@@ -27,8 +46,30 @@ std::string help_text =
 
     "Command line arguments:\n\n"
     "  --port, -p <port>                    Port number. Default is " + std::to_string(port) + "\n"
-    "  --connections, -c <connections>      Maximum number of Websocket clients, 1-64. Default is " + std::to_string(maxConnections) + "\n"
+    "  --connections, -c <connections>      Maximum number of Websocket clients, 1-100000. Default is " + std::to_string(maxConnections) + "\n"
+    "  --threads, -t <threads>              Number of threads processing messages, 1-256. Default is " + std::to_string(threads) + "\n"
+    "  --watermark, -w <KB>                 Kilobytes buffered for a client before further messages are queued. Default is " + std::to_string(send_watermark / 1024) + "\n"
+    "  --queue_limit, -q <KB>               Kilobytes queued for a slow client before messages are dropped. Default is " + std::to_string(send_queue_limit / 1024) + "\n"
+    "  --overflow, -o <policy>              What to do with a full queue: drop_oldest, drop_newest or disconnect. Default is drop_oldest\n"
+    "  --ping, -pi <seconds>                Ping every client this often. 0 disables pings. Default is " + std::to_string(ping_interval) + "\n"
+    "  --ping_misses, -pm <pings>           Disconnect a client that didn't answer this many pings in a row. Default is " + std::to_string(ping_misses) + "\n"
+    "  --hello_timeout, -ht <seconds>       Disconnect a client that didn't say hello within this time. 0: no limit. Default is " + std::to_string(hello_timeout) + "\n"
+    "  --mailbox, -m <messages>             Keep up to this many messages for each offline client, and send them when it connects. Default is 0 (off)\n"
+    "  --mailbox_size, -ms <KB>             Kilobytes kept for each offline client. Default is " + std::to_string(mailbox_bytes / 1024) + "\n"
+    "  --mailbox_ttl, -mt <seconds>         Stored messages older than this are discarded. Default is " + std::to_string(mailbox_ttl) + "\n"
+    "  --mailbox_dir, -md <path>            Keep mailboxes in memory-mapped files in this directory, so they survive a restart\n"
     "  --log, -l                            Logging on\n"
     "  --verbose                            Verbose logging (enables websocketpp messages)\n"
+    "  --deflate, -z                        Compress messages with permessage-deflate, if the other side agrees (needs a 'deflate' build)\n"
+    "  --deflate_threshold, -zt <bytes>     Messages smaller than this are sent uncompressed. Default: 256\n"
+    "  --deflate_window, -zw <bits>         Compression window, 9-15 bits. Smaller uses less memory per connection. Default: 15\n"
+    "  --deflate_no_context, -zn            Compress every message on its own (less memory, worse ratio)\n"
+    "  --nagle                              Leave Nagle's algorithm on: fewer packets, but short messages may wait up to 40 ms\n"
+    "  --send_buffer, -sb <KB>              Socket send buffer of each connection. Default is the system's\n"
+    "  --receive_buffer, -rb <KB>           Socket receive buffer of each connection. Default is the system's\n"
+    "  --log_format, -lf <text|binary>      Log record format. Binary records are <u64 time (us)><u16 type length><u32 length><type><message>. Default: text\n"
+    "  --log_file, -lo <path>               Write the log to a file instead of the console\n"
+    "  --log_overflow, -lv <drop|block>     What to do when log records come faster than they can be written. Default: drop\n"
+    "  --log_buffer, -lb <records>          Number of log records buffered. Default: 4096\n"
     "  --version, -v                        Version information\n"
     "\n";
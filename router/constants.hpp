@@ -18,6 +18,30 @@ extern int port;
 //  Maximum number of connections
 extern int maxConnections;
 
+//  Number of threads running the Websocket event loop
+extern int threads;
+
+//  Outbound queue of each client
+//  Messages are handed to Websocket++ until it buffers "send_watermark" bytes for the client. After that they are queued,
+//  up to "send_queue_limit" bytes, then "send_overflow" decides what happens.
+enum class Overflow { drop_oldest, drop_newest, disconnect };
+extern size_t send_watermark;
+extern size_t send_queue_limit;
+extern Overflow send_overflow;
+
+//  Liveness: seconds between pings (0: no pings), pings a client may leave unanswered before it is disconnected, and
+//  seconds a new connection has to say hello (0: no limit)
+extern int ping_interval;
+extern int ping_misses;
+extern int hello_timeout;
+
+//  Store-and-forward mailboxes of offline clients (see mailbox.hpp): messages (0: off), bytes and seconds each, and
+//  the directory of their spool files (empty: in memory)
+extern int mailbox_messages;
+extern size_t mailbox_bytes;
+extern int mailbox_ttl;
+extern std::string mailbox_dir;
+
 //  Help text
 extern std::string help_text;
 
@@ -0,0 +1,181 @@
+//  mailbox.cpp
+#include <chrono>
+#include <string>
+#include <unistd.h>
+
+#include "asio_ws.hpp"
+#include "constants.hpp"
+#include "mailbox.hpp"
+#include "registry.hpp"
+#include "../core/utils.hpp"
+
+Mailboxes mailboxes;
+
+//  Messages to any number of made-up IDs must not exhaust the router
+static const size_t max_mailboxes = 256;
+
+//  Spool records carry a small header each
+static const size_t spool_record_overhead = 24;
+
+//  Spool record flag of a binary message
+static const uint32_t spool_binary = 1;
+
+static int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string spool_path(const std::string& id) {
+    return mailbox_dir + "/" + id + ".mbox";
+}
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+//  The mailbox of a client, or nullptr. A spool file left by an earlier run is picked up here.
+Mailboxes::Box* Mailboxes::open(const std::string& id, bool create) {
+    auto it = boxes.find(id);
+    if (it != boxes.end())
+        return &it->second;
+
+    if (mailbox_dir.empty() ? !create : (!create && access(spool_path(id).c_str(), F_OK) != 0))
+        return nullptr;
+
+    //  Mailboxes whose messages all expired make room
+    if (boxes.size() >= max_mailboxes) {
+        const int64_t now = now_ms();
+        for (auto box = boxes.begin(); box != boxes.end(); ) {
+            expire(box->second, now);
+            if (box->second.messages.empty() && (!box->second.spool || box->second.spool->empty())) {
+                if (box->second.spool)
+                    unlink(spool_path(box->first).c_str());
+                box = boxes.erase(box);
+            }
+            else
+                ++box;
+        }
+    }
+    if (boxes.size() >= max_mailboxes) {
+        log("ERROR", "Too many mailboxes, no mailbox for \"" + id + "\"");
+        return nullptr;
+    }
+
+    Box& box = boxes[id];
+    if (!mailbox_dir.empty()) {
+        box.spool = std::make_unique<Spool>();
+        if (!box.spool->open(spool_path(id), mailbox_bytes + static_cast<size_t>(mailbox_messages) * spool_record_overhead)) {
+            boxes.erase(id);
+            return nullptr;
+        }
+    }
+    return &box;
+}
+
+void Mailboxes::expire(Box& box, int64_t now) {
+    const int64_t oldest = now - static_cast<int64_t>(mailbox_ttl) * 1000;
+
+    while (!box.messages.empty() && box.messages.front().time < oldest) {
+        box.bytes -= box.messages.front().message.size();
+        box.messages.pop_front();
+        ++expired;
+    }
+
+    std::string_view message;
+    int64_t time;
+    while (box.spool && box.spool->front(message, time) && time < oldest) {
+        box.spool->pop();
+        ++expired;
+    }
+}
+
+Mailboxes::Result Mailboxes::store(const std::string& id, websocketpp::connection_hdl& hdl, std::string_view message, bool binary) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    //  confirm() holds the lock from before the client is confirmed until its messages are out, so a message is either
+    //  stored before them or sent directly after them, never left behind
+    if (registry.find(id, hdl))
+        return Result::online;
+
+    Box* box = open(id, true);
+    if (!box)
+        return Result::full;
+
+    const int64_t now = now_ms();
+    expire(*box, now);
+
+    if (box->spool) {
+        //  The size of the spool file is the byte limit
+        if (box->spool->size() >= static_cast<size_t>(mailbox_messages) || !box->spool->push(message, now, binary ? spool_binary : 0))
+            return Result::full;
+        return Result::stored;
+    }
+
+    if (box->messages.size() >= static_cast<size_t>(mailbox_messages) || box->bytes + message.size() > mailbox_bytes)
+        return Result::full;
+
+    box->messages.push_back({std::string(message), now, binary});
+    box->bytes += message.size();
+    return Result::stored;
+}
+
+bool Mailboxes::confirm(websocketpp::connection_hdl hdl, Session& session, const std::string& id, websocketpp::connection_hdl& replaced) {
+    //  Counted before the client can be found in the registry: a sender that finds it sees the count, and waits
+    ++delivering;
+    bool confirmed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        confirmed = registry.confirm(hdl, session, id, replaced);
+        if (confirmed)
+            deliver(id, hdl);
+    }
+    --delivering;
+    return confirmed;
+}
+
+void Mailboxes::wait_delivery() {
+    //  confirm() holds the lock until the stored messages are out
+    if (delivering.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+}
+
+//  Called by confirm() under the lock
+void Mailboxes::deliver(const std::string& id, websocketpp::connection_hdl hdl) {
+    Box* box = open(id, false);
+    if (!box)
+        return;
+
+    expire(*box, now_ms());
+
+    size_t count = 0;
+    for (auto& entry : box->messages) {
+        send_message(hdl, entry.message, entry.binary ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text);
+        ++count;
+    }
+
+    std::string_view message;
+    int64_t time;
+    uint32_t flags;
+    while (box->spool && box->spool->front(message, time, flags)) {
+        send_message(hdl, message, (flags & spool_binary) ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text);
+        box->spool->pop();
+        ++count;
+    }
+
+    if (box->spool) {
+        box->spool->close();
+        unlink(spool_path(id).c_str());
+    }
+    boxes.erase(id);
+
+    if (count)
+        log("LOG", "Delivered " + std::to_string(count) + " stored message(s) to " + id);
+}
+
+std::string Mailboxes::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t stored = 0;
+    for (const auto& box : boxes)
+        stored += box.second.spool ? box.second.spool->size() : box.second.messages.size();
+
+    return std::to_string(boxes.size()) + ":" + std::to_string(stored) + ":" + std::to_string(expired);
+}
@@ -0,0 +1,68 @@
+//  mailbox.hpp
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#define ASIO_STANDALONE
+#include <websocketpp/common/connection_hdl.hpp>
+
+#include "../core/spool.hpp"
+
+struct Session;
+
+//  Store-and-forward mailboxes -----------------------------------------------------------------------------------------
+//  With --mailbox, messages to a client that isn't connected are kept for it, up to a number of messages, bytes and
+//  seconds each, instead of being answered with error 3. They are sent in one burst when the client confirms its ID.
+//  With --mailbox_dir, each mailbox is a memory-mapped spool file there, so it survives a restart of the router.
+//
+//  Stored messages go out before any newer one: the client is confirmed and its mailbox emptied under the lock, which
+//  store() takes too, and a message sent directly to a confirmed client waits for a delivery that may be running.
+
+class Mailboxes {
+public:
+    enum class Result { stored, online, full };
+
+    //  Keeps a message for an offline client. "online" means the client was confirmed meanwhile: send it directly.
+    //  Binary messages are delivered as binary frames.
+    Result store(const std::string& id, websocketpp::connection_hdl& hdl, std::string_view message, bool binary);
+
+    //  registry.confirm(), then sends everything kept for the client before anything else can be sent to it
+    bool confirm(websocketpp::connection_hdl hdl, Session& session, const std::string& id, websocketpp::connection_hdl& replaced);
+
+    //  Returns once a delivery that may be running is done. Call it before sending to a client found in the registry.
+    void wait_delivery();
+
+    //  <mailboxes>:<stored messages>:<expired>
+    std::string stats();
+
+private:
+    struct Entry {
+        std::string message;
+        int64_t time;
+        bool binary;
+    };
+
+    struct Box {
+        std::deque<Entry> messages;
+        size_t bytes = 0;
+        std::unique_ptr<Spool> spool;       //  Instead of "messages" with --mailbox_dir
+    };
+
+    Box* open(const std::string& id, bool create);
+    void expire(Box& box, int64_t now);
+    void deliver(const std::string& id, websocketpp::connection_hdl hdl);
+
+    std::mutex mutex;
+    std::atomic<int> delivering{0};         //  confirm() calls running, so senders only lock while one does
+    std::unordered_map<std::string, Box> boxes;
+    uint64_t expired = 0;
+};
+
+extern Mailboxes mailboxes;
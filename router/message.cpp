@@ -0,0 +1,38 @@
+//  message.cpp
+#include <string_view>
+
+#include "message.hpp"
+
+//  Message header parser -----------------------------------------------------------------------------------------------
+MessageHeader parse_header(std::string_view payload) {
+    static constexpr std::string_view delim = "::";
+
+    MessageHeader header;
+    std::string_view* fields[] = { &header.recipient, &header.sender, &header.expects_reply, &header.reply_to };
+
+    size_t prev = 0;
+    for (std::string_view* field : fields) {
+        size_t pos = payload.find(delim, prev);
+        ++header.fields;
+
+        if (pos == std::string_view::npos) {
+            *field = payload.substr(prev);
+            prev = std::string_view::npos;
+            break;
+        }
+
+        *field = payload.substr(prev, pos - prev);
+        prev = pos + delim.size();
+
+        if (field == fields[0])
+            header.forward = payload.substr(prev);
+    }
+
+    //  Whatever follows the fourth delimiter is the payload, "::" included
+    if (prev != std::string_view::npos) {
+        header.content = payload.substr(prev);
+        ++header.fields;
+    }
+
+    return header;
+}
@@ -0,0 +1,22 @@
+//  message.hpp
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+//  Message header ------------------------------------------------------------------------------------------------------
+//  <recipient>::<sender>::<reply expected>::<reply to>::<payload>
+//  Only the first four delimiters are searched for. Every field is a view into the received payload,
+//  so nothing is copied and the payload is never scanned.
+
+struct MessageHeader {
+    std::string_view recipient;
+    std::string_view sender;
+    std::string_view expects_reply;     //  Command name in router commands
+    std::string_view reply_to;          //  Command argument in router commands
+    std::string_view content;
+    std::string_view forward;           //  Everything after "<recipient>::", as forwarded to the recipient
+    size_t fields = 0;                  //  Number of fields found, at most 5
+};
+
+MessageHeader parse_header(std::string_view payload);
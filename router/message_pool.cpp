@@ -0,0 +1,63 @@
+//  message_pool.cpp
+#include <new>
+#include <string>
+
+#include "message_pool.hpp"
+
+PoolCounters pool_counters;
+
+std::string pool_stats() {
+    return std::to_string(pool_counters.allocated) + ":" + std::to_string(pool_counters.reused) + ":" +
+        std::to_string(pool_counters.freed) + ":" + std::to_string(pool_counters.pooled) + ":" +
+        std::to_string(pool_counters.blocks);
+}
+
+//  Reference count blocks ----------------------------------------------------------------------------------------------
+//  A shared_ptr with a deleter and an allocator keeps both in its block, a few pointers in all. Free blocks are
+//  linked through their first bytes.
+
+static const size_t block_size = 64;
+static const size_t block_limit = 8192;     //  Free blocks kept per thread
+
+struct FreeBlocks {
+    void* head = nullptr;
+    size_t count = 0;
+
+    ~FreeBlocks();
+};
+
+static thread_local bool blocks_closed = false;
+static thread_local FreeBlocks free_blocks;
+
+FreeBlocks::~FreeBlocks() {
+    blocks_closed = true;
+    while (head) {
+        void* next = *static_cast<void**>(head);
+        ::operator delete(head);
+        head = next;
+    }
+    count = 0;
+}
+
+void* allocate_block(size_t size) {
+    if (size <= block_size && !blocks_closed && free_blocks.head) {
+        void* block = free_blocks.head;
+        free_blocks.head = *static_cast<void**>(block);
+        --free_blocks.count;
+        return block;
+    }
+
+    ++pool_counters.blocks;
+    return ::operator new(size <= block_size ? block_size : size);
+}
+
+void free_block(void* block, size_t size) {
+    if (size > block_size || blocks_closed || free_blocks.count >= block_limit) {
+        ::operator delete(block);
+        return;
+    }
+
+    *static_cast<void**>(block) = free_blocks.head;
+    free_blocks.head = block;
+    ++free_blocks.count;
+}
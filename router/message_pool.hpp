@@ -0,0 +1,172 @@
+//  message_pool.hpp
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <websocketpp/frame.hpp>
+
+//  Pooled Websocket messages -------------------------------------------------------------------------------------------
+//  Websocket++ creates a message object for every frame it reads, and for every frame it sends, and its payload buffer
+//  is allocated again each time. Here a released message keeps its buffer and goes back to a free list of its size
+//  class instead, and the next message of that size takes it from there, so forwarding at a steady rate doesn't
+//  allocate at all. Messages come with a shared_ptr whose reference count block is taken from a free list too.
+//
+//  Free lists belong to a thread, without locking. A message released on another thread than the one that took it
+//  simply joins the free lists of that thread. Each list keeps a limited number of messages, and buffers larger than
+//  the largest class are never kept, so the pool holds a few megabytes per thread at most.
+
+//  Allocation counters of every thread, see the "pool" command
+struct PoolCounters {
+    std::atomic<uint64_t> allocated{0};     //  Messages created on the heap
+    std::atomic<uint64_t> reused{0};        //  Messages taken from a free list
+    std::atomic<uint64_t> freed{0};         //  Messages deleted: too large to keep, or their free list was full
+    std::atomic<int64_t> pooled{0};         //  Messages waiting in free lists
+    std::atomic<uint64_t> blocks{0};        //  Reference count blocks created on the heap
+};
+
+extern PoolCounters pool_counters;
+
+//  <allocated>:<reused>:<freed>:<pooled>:<blocks>
+std::string pool_stats();
+
+//  Fixed size blocks for reference counts, from a free list of the calling thread
+void* allocate_block(size_t size);
+void free_block(void* block, size_t size);
+
+template <typename T>
+class block_allocator {
+public:
+    typedef T value_type;
+
+    block_allocator() = default;
+    template <typename U>
+    block_allocator(const block_allocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(allocate_block(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { free_block(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const block_allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const block_allocator<U>&) const { return false; }
+};
+
+//  Message manager of Websocket++ connections (con_msg_manager_type in config.hpp) -------------------------------------
+template <typename message>
+class pooled_msg_manager {
+public:
+    typedef pooled_msg_manager<message> type;
+    typedef std::shared_ptr<pooled_msg_manager> ptr;
+    typedef std::weak_ptr<pooled_msg_manager> weak_ptr;
+    typedef typename message::ptr message_ptr;
+
+    //  Outgoing frame of a connection, filled by Websocket++
+    message_ptr get_message() {
+        return make(websocketpp::frame::opcode::text, 0);
+    }
+
+    //  Incoming message, or outgoing payload of "size" bytes
+    message_ptr get_message(websocketpp::frame::opcode::value op, size_t size) {
+        return make(op, size);
+    }
+
+    //  Messages go back to the pool when their last reference is released, not through Websocket++
+    bool recycle(message*) {
+        return false;
+    }
+
+    //  A cleared message whose payload has room for "size" bytes
+    static message_ptr make(websocketpp::frame::opcode::value op, size_t size) {
+        message* msg = take(size);
+        msg->set_opcode(op);
+        return message_ptr(msg, recycler(), block_allocator<message>());
+    }
+
+private:
+    static const size_t classes = 4;
+    static constexpr size_t class_size[classes] = { 256, 4096, 65536, 1048576 };
+    static constexpr size_t class_limit[classes] = { 4096, 256, 32, 4 };     //  Messages kept per thread
+
+    struct recycler {
+        void operator()(message* msg) const { release(msg); }
+    };
+
+    struct FreeLists {
+        std::vector<message*> free[classes];
+
+        FreeLists() {
+            for (size_t i = 0; i < classes; ++i)
+                free[i].reserve(class_limit[i]);
+        }
+
+        ~FreeLists() {
+            closed = true;
+            for (auto& list : free) {
+                for (message* msg : list)
+                    delete msg;
+                pool_counters.pooled -= static_cast<int64_t>(list.size());
+                pool_counters.freed += list.size();
+            }
+        }
+    };
+
+    //  Messages released while a thread exits, after its free lists are gone, are deleted
+    static inline thread_local bool closed = false;
+
+    static FreeLists& lists() {
+        static thread_local FreeLists lists;
+        return lists;
+    }
+
+    static message* take(size_t size) {
+        size_t cls = 0;
+        while (cls < classes && class_size[cls] < size)
+            ++cls;
+
+        if (cls < classes && !closed) {
+            auto& list = lists().free[cls];
+            if (!list.empty()) {
+                message* msg = list.back();
+                list.pop_back();
+                ++pool_counters.reused;
+                --pool_counters.pooled;
+                return msg;
+            }
+        }
+
+        ++pool_counters.allocated;
+        return new message(typename message::con_msg_man_ptr(), websocketpp::frame::opcode::text,
+            cls < classes ? class_size[cls] : size);
+    }
+
+    static void release(message* msg) {
+        const size_t capacity = msg->get_raw_payload().capacity();
+
+        //  The largest class it has room for
+        size_t cls = classes;
+        while (cls > 0 && class_size[cls - 1] > capacity)
+            --cls;
+
+        if (cls == 0 || capacity > class_size[classes - 1] || closed || lists().free[cls - 1].size() >= class_limit[cls - 1]) {
+            delete msg;
+            ++pool_counters.freed;
+            return;
+        }
+
+        msg->get_raw_payload().clear();
+        msg->set_header("");
+        msg->set_prepared(false);
+        msg->set_fin(true);
+        msg->set_terminal(false);
+        msg->set_compressed(false);
+
+        lists().free[cls - 1].push_back(msg);
+        ++pool_counters.pooled;
+    }
+};
@@ -0,0 +1,148 @@
+//  registry.cpp
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "registry.hpp"
+
+ClientRegistry registry;
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+void ClientRegistry::reserve(size_t connections) {
+    std::unique_lock lock(mutex);
+    unconfirmed_clients.reserve(connections);
+    clients.reserve(connections);
+}
+
+int ClientRegistry::add_unconfirmed(websocketpp::connection_hdl hdl, Session& session, int limit) {
+    std::unique_lock lock(mutex);
+    const int conns = static_cast<int>(unconfirmed_clients.size() + clients.size());
+    if (conns >= limit)
+        return -1;
+
+    unconfirmed_clients.emplace(&session, hdl);
+    return conns + 1;
+}
+
+bool ClientRegistry::confirm(websocketpp::connection_hdl hdl, Session& session, const std::string& id, websocketpp::connection_hdl& replaced) {
+    std::unique_lock lock(mutex);
+
+    if (!unconfirmed_clients.erase(&session))
+        return false;
+
+    auto existing = clients.find(id);
+    if (existing != clients.end()) {
+        replaced = existing->second.hdl;
+        clients.erase(existing);
+    }
+
+    session.id = id;
+    session.confirmed = true;
+    clients.emplace(id, Client(hdl, id, &session));
+    return true;
+}
+
+bool ClientRegistry::remove(Session& session) {
+    std::unique_lock lock(mutex);
+
+    if (unconfirmed_clients.erase(&session))
+        return true;
+
+    //  The ID may have been taken over by a newer connection in the meantime
+    auto it = clients.find(session.id);
+    if (it == clients.end() || it->second.session != &session)
+        return false;
+
+    clients.erase(it);
+    return true;
+}
+
+bool ClientRegistry::erase_unconfirmed(Session& session) {
+    std::unique_lock lock(mutex);
+    return unconfirmed_clients.erase(&session) > 0;
+}
+
+std::vector<Client> ClientRegistry::take(bool all) {
+    std::unique_lock lock(mutex);
+    std::vector<Client> taken;
+    taken.reserve(unconfirmed_clients.size() + (all ? clients.size() : 0));
+
+    for (auto& [session, hdl] : unconfirmed_clients)
+        taken.emplace_back(hdl, "", session);
+    unconfirmed_clients.clear();
+
+    if (all) {
+        for (auto& [id, client] : clients)
+            taken.push_back(std::move(client));
+        clients.clear();
+    }
+    return taken;
+}
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+bool ClientRegistry::find(const std::string& id, websocketpp::connection_hdl& hdl) const {
+    std::shared_lock lock(mutex);
+    auto it = clients.find(id);
+    if (it == clients.end())
+        return false;
+    hdl = it->second.hdl;
+    return true;
+}
+
+std::vector<Client> ClientRegistry::confirmed() const {
+    std::shared_lock lock(mutex);
+    std::vector<Client> result;
+    result.reserve(clients.size());
+    for (const auto& [id, client] : clients)
+        result.push_back(client);
+    return result;
+}
+
+//  Handles of every confirmed client except one, for broadcasting
+std::vector<websocketpp::connection_hdl> ClientRegistry::handles(const std::string& except) const {
+    std::shared_lock lock(mutex);
+    std::vector<websocketpp::connection_hdl> result;
+    result.reserve(clients.size());
+    for (const auto& [id, client] : clients) {
+        if (id != except)
+            result.push_back(client.hdl);
+    }
+    return result;
+}
+
+std::vector<Client> ClientRegistry::unconfirmed() const {
+    std::shared_lock lock(mutex);
+    std::vector<Client> result;
+    result.reserve(unconfirmed_clients.size());
+    for (const auto& [session, hdl] : unconfirmed_clients)
+        result.emplace_back(hdl, "", session);
+    return result;
+}
+
+std::string ClientRegistry::list_ids() const {
+    std::shared_lock lock(mutex);
+    std::string list;
+    for (const auto& [id, _] : clients) {
+        if (!list.empty()) list += ",";
+        list += id;
+    }
+    return list;
+}
+
+size_t ClientRegistry::confirmed_count() const {
+    std::shared_lock lock(mutex);
+    return clients.size();
+}
+
+size_t ClientRegistry::unconfirmed_count() const {
+    std::shared_lock lock(mutex);
+    return unconfirmed_clients.size();
+}
+
+size_t ClientRegistry::size() const {
+    std::shared_lock lock(mutex);
+    return unconfirmed_clients.size() + clients.size();
+}
@@ -0,0 +1,65 @@
+//  registry.hpp
+#pragma once
+
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <websocketpp/common/connection_hdl.hpp>
+
+#include "session.hpp"
+
+//  Unconfirmed and confirmed Websocket clients
+struct Client {
+    websocketpp::connection_hdl hdl;
+    std::string id;
+    Session* session;
+    Client(websocketpp::connection_hdl h = websocketpp::connection_hdl(), const std::string& i = "", Session* s = nullptr)
+        : hdl(h), id(i), session(s) {}
+};
+
+//  Client registry -----------------------------------------------------------------------------------------------------
+//  Every io thread reads it on every message, but it only changes on connect, hello and disconnect, so a
+//  shared (reader/writer) lock is used. Handles are returned by value and never closed under the lock.
+//  Unconfirmed clients are indexed by their session, confirmed ones by ID, so no operation walks the table.
+
+class ClientRegistry {
+public:
+    //  Sizes the tables for "connections" clients up front, so they don't rehash while thousands connect at once
+    void reserve(size_t connections);
+
+    //  Registers a new connection, unless the router is full. Returns the new connection count or -1.
+    int add_unconfirmed(websocketpp::connection_hdl hdl, Session& session, int limit);
+
+    //  Moves an unconfirmed connection to the confirmed list under the given ID.
+    //  Returns false if the connection wasn't unconfirmed. A client previously holding the same ID is returned in "replaced".
+    bool confirm(websocketpp::connection_hdl hdl, Session& session, const std::string& id, websocketpp::connection_hdl& replaced);
+
+    //  Removes a closed connection. Returns false if it wasn't registered (anymore).
+    bool remove(Session& session);
+
+    //  Removes an unconfirmed client by session
+    bool erase_unconfirmed(Session& session);
+
+    //  Removes and returns every unconfirmed client, and every confirmed one as well if "all" is set
+    std::vector<Client> take(bool all);
+
+    bool find(const std::string& id, websocketpp::connection_hdl& hdl) const;
+    std::vector<Client> confirmed() const;
+    std::vector<websocketpp::connection_hdl> handles(const std::string& except = "") const;
+    std::vector<Client> unconfirmed() const;
+    std::string list_ids() const;
+
+    size_t confirmed_count() const;
+    size_t unconfirmed_count() const;
+    size_t size() const;
+
+private:
+    mutable std::shared_mutex mutex;
+    std::unordered_map<Session*, websocketpp::connection_hdl> unconfirmed_clients;
+    std::unordered_map<std::string, Client> clients;
+};
+
+extern ClientRegistry registry;
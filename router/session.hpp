@@ -0,0 +1,48 @@
+//  session.hpp
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <websocketpp/common/connection_hdl.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+
+#include "message_pool.hpp"
+#include "../core/timer_wheel.hpp"
+
+//  Websocket message of the router, recycled through the message pool
+typedef websocketpp::message_buffer::message<pooled_msg_manager> message_type;
+
+//  Per-connection state ------------------------------------------------------------------------------------------------
+//  Websocket++ derives every connection from the connection_base of its config (see config.hpp),
+//  so this is stored inside the connection object and is found from a handle in constant time.
+//  Its timer wheel entry drives the hello deadline and the pings of the connection (see asio_ws.cpp).
+
+struct Session : TimerWheel::Entry {
+    ~Session() { leave(); }
+
+    std::string id;                             //  Client ID, set when the client is confirmed
+    std::atomic<bool> confirmed{false};
+    std::atomic<uint64_t> received{0};          //  Messages received from this client
+    std::atomic<uint64_t> sent{0};              //  Messages sent to this client
+    bool deflate = false;                       //  permessage-deflate was negotiated
+    std::vector<std::string> topics;            //  Subscriptions, guarded by the topic index
+
+    //  Liveness. The handle is set before the timer wheel entry is first scheduled.
+    websocketpp::connection_hdl hdl;
+    std::atomic<int> unanswered_pings{0};
+
+    //  Outbound queue. Messages wait here while Websocket++ already buffers more than the watermark for this client.
+    //  A list, as most clients never queue anything and an empty std::deque already allocates over 500 bytes.
+    std::mutex queue_mutex;
+    std::list<message_type::ptr> queue;
+    size_t queued_bytes = 0;
+    bool drain_scheduled = false;
+    bool overflowing = false;
+    std::atomic<uint64_t> dropped{0};           //  Messages dropped because the queue was full
+};
@@ -0,0 +1,148 @@
+//  topics.cpp
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "topics.hpp"
+#include "../core/utils.hpp"
+
+TopicIndex topics;
+
+//  Splits a topic into its levels
+static std::vector<std::string_view> split_levels(std::string_view topic) {
+    std::vector<std::string_view> levels;
+    size_t prev = 0, pos;
+    while ((pos = topic.find('/', prev)) != std::string_view::npos) {
+        levels.push_back(topic.substr(prev, pos - prev));
+        prev = pos + 1;
+    }
+    levels.push_back(topic.substr(prev));
+    return levels;
+}
+
+//  Validates a topic, or a subscription pattern if "pattern" is set
+bool is_valid_topic(std::string_view topic, bool pattern) {
+    auto levels = split_levels(topic);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        if (pattern && levels[i] == "+")
+            continue;
+        if (pattern && levels[i] == "#" && i == levels.size() - 1)
+            continue;
+        if (!is_valid_id(levels[i]))
+            return false;
+    }
+    return true;
+}
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+bool TopicIndex::subscribe(const std::string& pattern, Session& session, websocketpp::connection_hdl hdl) {
+    std::unique_lock lock(mutex);
+
+    Node* node = &root;
+    for (auto level : split_levels(pattern)) {
+        auto& child = node->children[std::string(level)];
+        if (!child)
+            child = std::make_unique<Node>();
+        node = child.get();
+    }
+
+    if (!node->subscribers.emplace(&session, hdl).second)
+        return false;
+
+    session.topics.push_back(pattern);
+    return true;
+}
+
+bool TopicIndex::unsubscribe(const std::string& pattern, Session& session) {
+    std::unique_lock lock(mutex);
+
+    auto it = std::find(session.topics.begin(), session.topics.end(), pattern);
+    if (it == session.topics.end())
+        return false;
+
+    session.topics.erase(it);
+    return erase(pattern, session);
+}
+
+void TopicIndex::remove(Session& session) {
+    std::unique_lock lock(mutex);
+
+    for (const auto& pattern : session.topics)
+        erase(pattern, session);
+    session.topics.clear();
+}
+
+//  Removes a subscriber and prunes the branches left empty. Call with the lock held.
+bool TopicIndex::erase(const std::string& pattern, Session& session) {
+    auto levels = split_levels(pattern);
+    std::vector<std::pair<Node*, std::string>> path;
+
+    Node* node = &root;
+    for (auto level : levels) {
+        auto it = node->children.find(std::string(level));
+        if (it == node->children.end())
+            return false;
+        path.emplace_back(node, it->first);
+        node = it->second.get();
+    }
+
+    bool erased = node->subscribers.erase(&session) > 0;
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        Node* child = it->first->children[it->second].get();
+        if (!child->subscribers.empty() || !child->children.empty())
+            break;
+        it->first->children.erase(it->second);
+    }
+    return erased;
+}
+
+//  ---------------------------------------------------------------------------------------------------------------------
+
+void TopicIndex::collect(const Node& node, const std::vector<std::string_view>& levels, size_t depth,
+    std::vector<std::pair<Session*, websocketpp::connection_hdl>>& out) const {
+
+    //  "#" matches the rest of the topic, including nothing
+    auto multi = node.children.find("#");
+    if (multi != node.children.end())
+        out.insert(out.end(), multi->second->subscribers.begin(), multi->second->subscribers.end());
+
+    if (depth == levels.size()) {
+        out.insert(out.end(), node.subscribers.begin(), node.subscribers.end());
+        return;
+    }
+
+    auto exact = node.children.find(std::string(levels[depth]));
+    if (exact != node.children.end())
+        collect(*exact->second, levels, depth + 1, out);
+
+    auto single = node.children.find("+");
+    if (single != node.children.end())
+        collect(*single->second, levels, depth + 1, out);
+}
+
+std::vector<websocketpp::connection_hdl> TopicIndex::match(std::string_view topic, const Session* except) const {
+    auto levels = split_levels(topic);
+    std::vector<std::pair<Session*, websocketpp::connection_hdl>> found;
+
+    {
+        std::shared_lock lock(mutex);
+        collect(root, levels, 0, found);
+    }
+
+    //  A client matching several of its own patterns still gets the message once
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<websocketpp::connection_hdl> result;
+    result.reserve(found.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        if (found[i].first == except || (i > 0 && found[i].first == found[i - 1].first))
+            continue;
+        result.push_back(found[i].second);
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+//  topics.hpp
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define ASIO_STANDALONE
+#include <websocketpp/common/connection_hdl.hpp>
+
+#include "session.hpp"
+
+//  Topic index ---------------------------------------------------------------------------------------------------------
+//  Topics are alphanumeric levels separated by "/", such as "sensors/kitchen/temp". A subscription may use "+" for
+//  exactly one level and "#" as its last level for any number of levels ("sensors/+/temp", "sensors/#").
+//  Subscriptions are stored in a trie of levels, so a publication only visits the branches that can match it,
+//  and its cost depends on the number of interested subscribers, not on the number of connected clients.
+
+bool is_valid_topic(std::string_view topic, bool pattern);
+
+class TopicIndex {
+public:
+    //  Both return false if nothing changed (already subscribed / wasn't subscribed)
+    bool subscribe(const std::string& pattern, Session& session, websocketpp::connection_hdl hdl);
+    bool unsubscribe(const std::string& pattern, Session& session);
+
+    //  Drops every subscription of a closing connection
+    void remove(Session& session);
+
+    //  Subscribers of a topic, each one only once
+    std::vector<websocketpp::connection_hdl> match(std::string_view topic, const Session* except = nullptr) const;
+
+private:
+    struct Node {
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+        std::unordered_map<Session*, websocketpp::connection_hdl> subscribers;
+    };
+
+    bool erase(const std::string& pattern, Session& session);
+    void collect(const Node& node, const std::vector<std::string_view>& levels, size_t depth,
+        std::vector<std::pair<Session*, websocketpp::connection_hdl>>& out) const;
+
+    mutable std::shared_mutex mutex;
+    Node root;
+};
+
+extern TopicIndex topics;
@@ -0,0 +1,58 @@
+//  registry_test.cpp
+//  Client registry: confirming, taking over an ID, and removing connections
+//
+//  g++ -std=c++17 -DROUTER -Icore/asio/asio/include -Icore/websocketpp -o registry_test tests/registry_test.cpp router/registry.cpp -pthread
+//  ./registry_test exits with 1 if a check fails.
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "../router/registry.hpp"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    std::printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+        ++failures;
+}
+
+static bool same(websocketpp::connection_hdl a, websocketpp::connection_hdl b) {
+    return !a.owner_before(b) && !b.owner_before(a);
+}
+
+//  A stand-in for a Websocket++ connection, which owns its session
+struct Connection {
+    std::shared_ptr<Session> session = std::make_shared<Session>();
+    websocketpp::connection_hdl hdl() const { return session; }
+};
+
+int main() {
+    ClientRegistry clients;
+    Connection first, second;
+    websocketpp::connection_hdl found, replaced;
+
+    //  The first connection confirms "camera"
+    check(clients.add_unconfirmed(first.hdl(), *first.session, 10) == 1, "first connection registered");
+    check(clients.confirm(first.hdl(), *first.session, "camera", replaced), "first connection confirmed");
+    check(replaced.expired(), "nothing replaced");
+
+    //  The client reconnects and says hello again before the old connection is gone
+    check(clients.add_unconfirmed(second.hdl(), *second.session, 10) == 2, "second connection registered");
+    check(clients.confirm(second.hdl(), *second.session, "camera", replaced), "second connection confirmed");
+    check(same(replaced, first.hdl()), "first connection returned as replaced");
+    check(clients.find("camera", found) && same(found, second.hdl()), "ID leads to the second connection");
+    check(clients.confirmed_count() == 1 && clients.unconfirmed_count() == 0, "one client registered");
+
+    //  The old connection closes: its close handler must not remove the new one
+    check(!clients.remove(*first.session), "closing the first connection removes nothing");
+    check(clients.find("camera", found) && same(found, second.hdl()), "ID still leads to the second connection");
+
+    //  The new connection closes
+    check(clients.remove(*second.session), "closing the second connection removes it");
+    check(!clients.find("camera", found) && clients.size() == 0, "registry empty");
+
+    std::printf("%s\n", failures ? "FAILED" : "All checks passed");
+    return failures ? 1 : 0;
+}
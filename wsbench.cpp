@@ -0,0 +1,67 @@
+#include <csignal>
+#include <string>
+#include <vector>
+
+//  Shared core functions
+#include "core/logger.hpp"
+#include "core/utils.hpp"
+
+//  Program-specific
+#include "bench/constants.hpp"
+#include "bench/commands.hpp"
+#include "bench/load.hpp"
+#include "bench/reconnect.hpp"
+#include "bench/report.hpp"
+
+//  Shutdown handlers ---------------------------------------------------------------------------------------------------------------------------------------------
+
+void shutdown(int signum) {
+    shutdown_handler(signum);
+    if (reconnect_downtime)
+        stop_reconnect();
+    else
+        stop_bench();
+}
+
+//  ================================================================================================================================================================
+
+int main(int argc, char* argv[]) {
+
+    //  Start!
+    std::signal(SIGINT, shutdown);
+    std::signal(SIGTERM, shutdown);
+
+    //  Several benchmarks may run at once, so there's no single instance check
+    if (!process_args(argc, argv))
+        return 1;
+
+    if (!start_logger())
+        return 1;
+
+    //  Every simulated client is a socket
+    raise_file_limit(static_cast<size_t>(clients) + 64);
+
+    //  Restart a stand-in router and time the clients' return, with each reconnection strategy
+    if (reconnect_downtime) {
+        std::vector<ReconnectResult> results;
+        print_reconnect_header();
+        bool ok = run_reconnect(results) && write_reconnect_results(results);
+        stop_logger();
+        return ok ? 0 : 1;
+    }
+
+    //  Run every pattern with every size, printing the results as they come
+    std::vector<RunResult> results;
+    print_header();
+    if (!run_bench(results)) {
+        stop_logger();
+        return 1;
+    }
+
+    //  Keep the results, then look for regressions
+    bool ok = write_results(results);
+    bool same = compare_baseline(results);
+
+    stop_logger();
+    return !ok ? 1 : !same ? 2 : 0;
+}
@@ -8,12 +8,15 @@
 #include <unistd.h>
 
 //  General utility functions
+#include "./core/logger.hpp"
 #include "./core/utils.hpp"
 
 //  Program-specific
 #include "./client/constants.hpp"
 #include "./client/commands.hpp"
 #include "./client/asio_ws.hpp"
+#include "./client/local.hpp"
+#include "./client/outbox.hpp"
 #include "./client/pipe.hpp"
 
 //  Shutdown handlers ---------------------------------------------------------------------------------------------------------------------------------------------
@@ -36,8 +39,12 @@ int main(int argc, char* argv[]) {
     if (!single_instance() || !process_args(argc, argv))
         return 1;
 
-    //  Initialize FIFO pipe watcher
-    else if (!init_pipe())
+    //  Initialize FIFO pipe watcher, local socket and outbox
+    else if (!init_pipe() || !init_local() || !init_outbox())
+        return 1;
+
+    //  Move logging off the io thread
+    if (!start_logger())
         return 1;
     
     //	Are we root?
@@ -49,7 +56,13 @@ int main(int argc, char* argv[]) {
     log("INFO", std::string("Remote shutdown is ") + (shutdown_enabled ? "enabled" : "disabled"));
 
     //  Initialize Websocket service
-    if (!init_websocket(process_commands))
+    bool ok = init_websocket(process_commands);
+
+    close_local();
+    close_pipe();
+    close_outbox();
+    stop_logger();
+    if (!ok)
       return 1;
 
     return 0;
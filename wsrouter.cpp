@@ -8,6 +8,7 @@
 #include <unistd.h>
 
 //  Shared core functions
+#include "core/logger.hpp"
 #include "core/utils.hpp"
 
 //  Program-specific
@@ -35,6 +36,13 @@ int main(int argc, char* argv[]) {
     if (!single_instance() || !process_args(argc, argv))
        return 1;
 
+    //  Move logging off the io threads
+    if (!start_logger())
+        return 1;
+
+    //  A descriptor for every connection, plus the listening socket, log and mailbox files
+    raise_file_limit(static_cast<size_t>(maxConnections) + 64);
+
     //	Are we root?
     // if (geteuid() != 0)
     //    log("WARNING", "This program should be run as root! Some features will not work without root privileges.");
@@ -43,6 +51,6 @@ int main(int argc, char* argv[]) {
     if (!init_websocket(process_commands))
       return 1;
 
-
+    stop_logger();
     return 0;
 }